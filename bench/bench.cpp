@@ -1,6 +1,7 @@
 #include "game/Level.hpp"
 #include "game/GameState.hpp"
 #include "logic/Solver.hpp"
+#include "logic/Portfolio.hpp"
 #include "util/FileUtil.hpp"
 
 #include <numeric>
@@ -9,6 +10,8 @@
 #include <memory>
 #include <chrono>
 #include <iomanip>
+#include <optional>
+#include <thread>
 
 using PLevel = std::shared_ptr<Level>;
 using PGameState = std::shared_ptr<GameState>;
@@ -17,10 +20,35 @@ using PSolver = std::shared_ptr<Solver>;
 constexpr int DEFAULT_ITERATIONS = 100;
 constexpr int MAX_ITERATIONS = 100000;
 
-void print_stats(const std::vector<std::vector<uint64_t>>& measures) {
+std::optional<SolverMode> mode_of(const std::string& name) {
+    if (name == "dfs") {
+        return SolverMode::GREEDY_DFS;
+    }
+    if (name == "astar") {
+        return SolverMode::A_STAR;
+    }
+    if (name == "idastar") {
+        return SolverMode::IDA_STAR;
+    }
+    if (name == "parallel") {
+        return SolverMode::PARALLEL;
+    }
+    if (name == "hdastar") {
+        return SolverMode::HDA_STAR;
+    }
+    if (name == "bidirectional") {
+        return SolverMode::BIDIRECTIONAL;
+    }
+    return std::nullopt;
+}
+
+constexpr double MICROS_PER_MILLI = 1000.0;
+
+// `measures` hold microseconds per iteration and level, they are printed in milliseconds
+void print_stats(const std::vector<std::vector<uint64_t>>& measures, const std::vector<SolverStats>& stats) {
     std::cout << std::fixed;
     std::cout << std::setprecision(2);
-    std::cout << "Level #\tAvg.\t\tTotal" << std::endl;
+    std::cout << "Level #\tAvg.\t\tTotal\t\tExpanded\tGenerated\tMatching cuts\tPattern cuts" << std::endl;
 
     size_t level_count = measures[0].size();
     std::vector<uint64_t> total_per_iteration;
@@ -31,25 +59,61 @@ void print_stats(const std::vector<std::vector<uint64_t>>& measures) {
     }
 
     uint64_t total = std::reduce(total_per_iteration.begin(), total_per_iteration.end());
-    double average = static_cast<double>(total) / static_cast<double>(measures.size());
+    double average = static_cast<double>(total) / MICROS_PER_MILLI / static_cast<double>(measures.size());
 
     for (size_t level = 0; level < level_count; ++level) {
         uint64_t total_per_level = 0;
         for (size_t iteration = 0; iteration < measures.size(); ++iteration) {
             total_per_level += measures[iteration][level];
         }
-        double average_per_level = static_cast<double>(total_per_level) / static_cast<double>(measures.size());
-        std::cout << level << "\t\t" << average_per_level << "\t\t" << total_per_level << "\n";
+        double average_per_level = static_cast<double>(total_per_level) / MICROS_PER_MILLI / static_cast<double>(measures.size());
+        std::cout << level << "\t\t" << average_per_level << "\t\t" << total_per_level / MICROS_PER_MILLI << "\t\t"
+                  << stats[level].expanded_nodes << "\t\t" << stats[level].generated_nodes << "\t\t"
+                  << stats[level].matching_cuts << "\t\t" << stats[level].pattern_cuts << "\n";
     }
     std::cout << "\n";
     std::cout << "Avg. iteration time " << average << " ms\n";
-    std::cout << "Total               " << total << " ms" << std::endl;
+    std::cout << "Total               " << total / MICROS_PER_MILLI << " ms" << std::endl;
+}
+
+void print_capacity_stats(const std::vector<PLevel>& levels,
+                          const std::vector<std::vector<uint64_t>>& measures,
+                          const std::vector<SolverStats>& stats) {
+    // throughput of every bitboard kernel, levels are grouped by the capacity they were solved with; timed
+    // in microseconds, as most levels take well under a millisecond
+    std::cout << "\nCapacity\tLevels\tExpanded\tTotal, ms\tNodes/s" << std::endl;
+    for (size_t capacity : {64, 128, 256, 0}) {
+        size_t level_count = 0;
+        uint64_t expanded = 0;
+        uint64_t micros = 0;
+        for (size_t level = 0; level < levels.size(); ++level) {
+            if (levels[level]->board_capacity() != capacity) {
+                continue;
+            }
+            ++level_count;
+            expanded += stats[level].expanded_nodes * measures.size();
+            for (const auto& iteration_measures : measures) {
+                micros += iteration_measures[level];
+            }
+        }
+        if (level_count == 0) {
+            continue;
+        }
+        double per_second = static_cast<double>(expanded) * 1e6 / static_cast<double>(std::max<uint64_t>(micros, 1));
+        std::cout << (capacity == 0 ? std::string("generic") : std::to_string(capacity)) << "\t\t" << level_count
+                  << "\t" << expanded << "\t\t" << micros / MICROS_PER_MILLI << "\t\t" << per_second << "\n";
+    }
+    std::cout.flush();
 }
 
-void run_benchmark(int iterations, const std::vector<PGameState>& states, const std::vector<PSolver>& solvers) {
+void run_benchmark(int iterations,
+                   const std::vector<PLevel>& levels,
+                   const std::vector<PGameState>& states,
+                   const std::vector<PSolver>& solvers) {
     namespace t = std::chrono;
     size_t level_count = states.size();
     std::vector<std::vector<uint64_t>> measures(iterations, std::vector<uint64_t>(level_count, 0));
+    std::vector<SolverStats> stats(level_count);
     std::cout << "Running";
     for (int i = 0; i < iterations; ++i) {
         std::cout << ".";
@@ -58,15 +122,88 @@ void run_benchmark(int iterations, const std::vector<PGameState>& states, const
             auto p_state = states[j];
             auto p_solver = solvers[j];
             auto start = t::steady_clock::now();
-            if (p_solver->solve(*p_state).empty()) {
+            SolveResult result = p_solver->solve(*p_state);
+            if (!result.solved()) {
                 throw std::logic_error("Unsolvable level encountered: #" + std::to_string(j));
             }
-            uint64_t millis = t::duration_cast<t::milliseconds>(t::steady_clock::now() - start).count();
-            measures[i][j] = millis;
+            measures[i][j] = t::duration_cast<t::microseconds>(t::steady_clock::now() - start).count();
+            stats[j] = result.stats; // the last iteration's, it starts with the deadlock patterns learned by the first one
         }
     }
     std::cout << std::endl;
-    print_stats(measures);
+    print_stats(measures, stats);
+    print_capacity_stats(levels, measures, stats);
+    std::cout << "Done." << std::endl;
+}
+
+void run_scaling(int iterations, SolverMode mode, const std::vector<PLevel>& levels, const std::vector<PGameState>& states) {
+    namespace t = std::chrono;
+    size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<size_t> thread_counts;
+    for (size_t threads = 1; threads < max_threads; threads *= 2) {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(max_threads);
+
+    std::cout << std::fixed;
+    std::cout << std::setprecision(2);
+    std::cout << "Threads\tTotal, ms\tSpeedup" << std::endl;
+
+    double baseline = 0;
+    for (size_t threads : thread_counts) {
+        std::vector<PSolver> solvers;
+        for (const auto& p_level : levels) {
+            solvers.push_back(std::make_shared<Solver>(*p_level, mode, threads));
+        }
+
+        auto start = t::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            for (size_t j = 0; j < states.size(); ++j) {
+                if (!solvers[j]->solve(*states[j]).solved()) {
+                    throw std::logic_error("Unsolvable level encountered: #" + std::to_string(j));
+                }
+            }
+        }
+        double millis = static_cast<double>(t::duration_cast<t::microseconds>(t::steady_clock::now() - start).count()) / 1000.0;
+        if (baseline == 0) {
+            baseline = millis;
+        }
+        std::cout << threads << "\t\t" << millis << "\t\t" << baseline / millis << "x" << std::endl;
+    }
+    std::cout << "Done." << std::endl;
+}
+
+void run_portfolio(int iterations, const std::vector<PLevel>& levels, const std::vector<PGameState>& states) {
+    namespace t = std::chrono;
+    std::cout << std::fixed;
+    std::cout << std::setprecision(2);
+    std::cout << "Level #\tAvg.\t\tMax\t\tWins per strategy" << std::endl;
+
+    double total = 0;
+    for (size_t j = 0; j < states.size(); ++j) {
+        Portfolio portfolio(*levels[j]);
+        std::vector<size_t> wins(Portfolio::default_strategies().size(), 0);
+        double level_total = 0;
+        double level_max = 0;
+        for (int i = 0; i < iterations; ++i) {
+            auto start = t::steady_clock::now();
+            if (!portfolio.solve(*states[j]).solved()) {
+                throw std::logic_error("Unsolvable level encountered: #" + std::to_string(j));
+            }
+            double millis = static_cast<double>(t::duration_cast<t::microseconds>(t::steady_clock::now() - start).count()) / 1000.0;
+            level_total += millis;
+            level_max = std::max(level_max, millis);
+            ++wins[*portfolio.winning_strategy()];
+        }
+        total += level_total;
+        std::cout << j << "\t\t" << level_total / iterations << "\t\t" << level_max << "\t\t";
+        for (size_t w : wins) {
+            std::cout << w << " ";
+        }
+        std::cout << "\n";
+    }
+    std::cout << "\n";
+    std::cout << "Avg. iteration time " << total / iterations << " ms\n";
     std::cout << "Done." << std::endl;
 }
 
@@ -74,7 +211,11 @@ int main(int argc, const char** argv) {
     namespace fs = std::filesystem;
 
     if (argc <= 1) {
-        std::cout << "Please provide path to directory with Sokoban levels as first argument." << std::endl;
+        std::cout << "Please provide path to directory with Sokoban levels as first argument.\n"
+                     "Optional second argument is amount of iterations, third one is solver mode: 'dfs', 'astar', 'idastar',\n"
+                     "'bidirectional', 'parallel' or 'hdastar' (multi-threaded modes report speedup per thread count),\n"
+                     "or 'portfolio' to race several strategies at once."
+                  << std::endl;
         std::cin.get();
         return 0;
     }
@@ -87,6 +228,18 @@ int main(int argc, const char** argv) {
     }
     std::sort(filenames.begin(), filenames.end());
 
+    SolverMode mode = SolverMode::GREEDY_DFS;
+    bool portfolio = argc > 3 && std::string(argv[3]) == "portfolio";
+    if (argc > 3 && !portfolio) {
+        auto o_mode = mode_of(argv[3]);
+        if (!o_mode) {
+            std::cout << "Unknown solver mode given: " << argv[3] << std::endl;
+            std::cin.get();
+            return 0;
+        }
+        mode = *o_mode;
+    }
+
     std::vector<PLevel> levels;
     std::vector<PGameState> states;
     std::vector<PSolver> solvers;
@@ -102,7 +255,7 @@ int main(int argc, const char** argv) {
         SokobanParseResult parsed_sokoban = std::get<SokobanParseResult>(v_parse_result);
         levels.push_back(std::make_shared<Level>(parsed_sokoban.level));
         states.push_back(std::make_shared<GameState>(*levels.back(), parsed_sokoban.player_position, parsed_sokoban.box_positions));
-        solvers.push_back(std::make_shared<Solver>(*levels.back()));
+        solvers.push_back(std::make_shared<Solver>(*levels.back(), mode));
     }
 
     int iterations = DEFAULT_ITERATIONS;
@@ -115,7 +268,13 @@ int main(int argc, const char** argv) {
         }
     }
 
-    run_benchmark(iterations, states, solvers);
+    if (portfolio) {
+        run_portfolio(iterations, levels, states);
+    } else if (mode == SolverMode::PARALLEL || mode == SolverMode::HDA_STAR) {
+        run_scaling(iterations, mode, levels, states);
+    } else {
+        run_benchmark(iterations, levels, states, solvers);
+    }
 
     solvers.clear();
     states.clear();
@@ -0,0 +1,287 @@
+#pragma once
+#include "../util/Hash.hpp"
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include <bit>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Set of cells addressed by `Level::index`, one bit per cell packed into 64-bit words. Set operations work on
+// whole words, so counting or comparing cells costs a handful of AND/popcount instructions per 64 cells.
+// Boards of up to INLINE_WORDS words (256 cells, most levels) live inside the object and never allocate.
+class Bitboard {
+public:
+    static constexpr size_t INLINE_WORDS = 4;
+
+    Bitboard() = default;
+    explicit Bitboard(size_t bits) : size((bits + 63) / 64) {
+        if (size > INLINE_WORDS) {
+            heap.assign(size, 0);
+        }
+    }
+    Bitboard(const Bitboard& other) : size(other.size), local(other.local), heap(other.heap) {}
+    Bitboard& operator=(const Bitboard& other) {
+        size = other.size;
+        local = other.local;
+        heap = other.heap; // reuses the capacity, a no-op for inline boards
+        return *this;
+    }
+    // The moved-from board is left empty: its heap words are gone, so it must not claim them any more
+    Bitboard(Bitboard&& other) noexcept
+            : size(std::exchange(other.size, 0)), local(other.local), heap(std::move(other.heap)) {}
+    Bitboard& operator=(Bitboard&& other) noexcept {
+        size = std::exchange(other.size, 0);
+        local = other.local;
+        heap = std::move(other.heap);
+        return *this;
+    }
+
+    void set(size_t i) {
+        data()[i / 64] |= uint64_t(1) << (i % 64);
+    }
+
+    void reset(size_t i) {
+        data()[i / 64] &= ~(uint64_t(1) << (i % 64));
+    }
+
+    bool test(size_t i) const {
+        return (data()[i / 64] >> (i % 64)) & 1;
+    }
+
+    size_t count() const {
+        size_t result = 0;
+        for (size_t i = 0; i < size; ++i) {
+            result += std::popcount(data()[i]);
+        }
+        return result;
+    }
+
+    // Amount of cells set in both boards, without building the intersection
+    size_t count_common(const Bitboard& other) const {
+        size_t result = 0;
+        for (size_t i = 0; i < size; ++i) {
+            result += std::popcount(data()[i] & other.data()[i]);
+        }
+        return result;
+    }
+
+    bool is_subset_of(const Bitboard& other) const {
+        for (size_t i = 0; i < size; ++i) {
+            if (data()[i] & ~other.data()[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Lowest set cell, NONE if the board is empty
+    size_t first() const {
+        for (size_t i = 0; i < size; ++i) {
+            if (data()[i]) {
+                return i * 64 + std::countr_zero(data()[i]);
+            }
+        }
+        return NONE;
+    }
+
+    // Lowest set cell after `i`, NONE if there is none
+    size_t next(size_t i) const {
+        ++i;
+        if (i >= size * 64) {
+            return NONE;
+        }
+        uint64_t word = data()[i / 64] & (~uint64_t(0) << (i % 64));
+        for (size_t w = i / 64; ; word = data()[w]) {
+            if (word) {
+                return w * 64 + std::countr_zero(word);
+            }
+            if (++w == size) {
+                return NONE;
+            }
+        }
+    }
+
+    template <class F>
+    void for_each(F&& f) const {
+        for (size_t i = 0; i < size; ++i) {
+            for (uint64_t word = data()[i]; word; word &= word - 1) {
+                f(i * 64 + std::countr_zero(word));
+            }
+        }
+    }
+
+    Bitboard& operator&=(const Bitboard& other) {
+        for (size_t i = 0; i < size; ++i) {
+            data()[i] &= other.data()[i];
+        }
+        return *this;
+    }
+
+    Bitboard& operator|=(const Bitboard& other) {
+        for (size_t i = 0; i < size; ++i) {
+            data()[i] |= other.data()[i];
+        }
+        return *this;
+    }
+
+    Bitboard& and_not(const Bitboard& other) {
+        for (size_t i = 0; i < size; ++i) {
+            data()[i] &= ~other.data()[i];
+        }
+        return *this;
+    }
+
+    bool operator==(const Bitboard& other) const {
+        return size == other.size && std::equal(data(), data() + size, other.data());
+    }
+
+    size_t hash() const {
+        uint64_t result = 0;
+        for (size_t i = 0; i < size; ++i) {
+            result = mix_hash(result ^ data()[i]);
+        }
+        return result;
+    }
+
+    // Amount of 64-bit words
+    size_t word_count() const {
+        return size;
+    }
+
+    // Memory the board owns beyond its own object, none for inline boards
+    size_t heap_bytes() const {
+        return heap.capacity() * sizeof(uint64_t);
+    }
+
+    // Cells of `passable` connected to `seed`. Every round grows the region by one step in all four directions
+    // at once: shifts by one bit reach the horizontal neighbours and shifts by `stride` bits the vertical ones.
+    // `passable` must be surrounded by cells that aren't passable (e.g. sentinel walls), so that a shift
+    // wrapping from one row into another never lands on a passable cell.
+    //
+    // Small boards get a kernel specialised for their capacity: word counts are compile-time constants, so the loops
+    // unroll and the whole region stays in registers. Larger boards take the generic loop.
+    static Bitboard flood_fill(size_t seed, const Bitboard& passable, size_t stride) {
+        Bitboard region(passable.size * 64);
+        if (passable.size <= 1) {
+            fill_fixed<1>(seed, passable, region, stride);
+        } else if (passable.size <= 2) {
+            fill_fixed<2>(seed, passable, region, stride);
+        } else if (passable.size <= 4) {
+            fill_fixed<4>(seed, passable, region, stride);
+        } else {
+            Bitboard grown = region;
+            region.set(seed);
+            uint64_t* current = region.data();
+            uint64_t* next = grown.data();
+            while (grow(current, passable.data(), next, region.size, stride)) {
+                std::swap(current, next);
+            }
+            if (current != region.data()) {
+                region = grown;
+            }
+        }
+        return region;
+    }
+
+    static constexpr size_t NONE = SIZE_MAX;
+private:
+    size_t size = 0;
+    std::array<uint64_t, INLINE_WORDS> local{};
+    std::vector<uint64_t> heap; // only used by boards that don't fit inline
+
+    uint64_t* data() {
+        return size > INLINE_WORDS ? heap.data() : local.data();
+    }
+
+    const uint64_t* data() const {
+        return size > INLINE_WORDS ? heap.data() : local.data();
+    }
+
+    template <size_t WORDS>
+    static void fill_fixed(size_t seed, const Bitboard& passable_board, Bitboard& result, size_t stride) {
+        // the board may be shorter than WORDS: the extra words are never passable, so they stay empty
+        std::array<uint64_t, WORDS> passable{};
+        std::array<uint64_t, WORDS> region{};
+        std::array<uint64_t, WORDS> next{};
+        std::copy(passable_board.data(), passable_board.data() + passable_board.size, passable.begin());
+        region[seed / 64] |= uint64_t(1) << (seed % 64);
+        while (grow(region.data(), passable.data(), next.data(), WORDS, stride)) {
+            region = next;
+        }
+        std::copy(region.begin(), region.begin() + result.size, result.data());
+    }
+
+    // One round of the fill: `out` = (`in` and its neighbours) & `passable`. Returns whether anything was added.
+    static bool grow(const uint64_t* in, const uint64_t* passable, uint64_t* out, size_t n, size_t stride) {
+        size_t q = stride / 64; // whole words of a vertical shift
+        size_t b = stride % 64; // and the remaining bits
+        uint64_t changed = 0;
+        size_t i = 0;
+#if defined(__AVX2__)
+        // Inner words have all their neighbours inside the board, so four of them are processed per instruction.
+        // Shift counts of 64 give zero in vector shifts, so `b == 0` needs no special case here.
+        __m128i one = _mm_cvtsi64_si128(1), top = _mm_cvtsi64_si128(63);
+        __m128i bits = _mm_cvtsi64_si128(static_cast<int64_t>(b)), rest = _mm_cvtsi64_si128(static_cast<int64_t>(64 - b));
+        __m256i vector_changed = _mm256_setzero_si256();
+        auto load = [] (const uint64_t* p) {
+            return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        };
+        for (; i < n && i < q + 1; ++i) {
+            changed |= grow_word(in, passable, out, n, i, q, b);
+        }
+        for (; i + q + 5 <= n; i += 4) {
+            __m256i word = load(in + i);
+            __m256i v = _mm256_or_si256(word, _mm256_sll_epi64(word, one));
+            v = _mm256_or_si256(v, _mm256_srl_epi64(word, one));
+            v = _mm256_or_si256(v, _mm256_srl_epi64(load(in + i - 1), top));
+            v = _mm256_or_si256(v, _mm256_sll_epi64(load(in + i + 1), top));
+            v = _mm256_or_si256(v, _mm256_sll_epi64(load(in + i - q), bits));
+            v = _mm256_or_si256(v, _mm256_srl_epi64(load(in + i - q - 1), rest));
+            v = _mm256_or_si256(v, _mm256_srl_epi64(load(in + i + q), bits));
+            v = _mm256_or_si256(v, _mm256_sll_epi64(load(in + i + q + 1), rest));
+            v = _mm256_and_si256(v, load(passable + i));
+            vector_changed = _mm256_or_si256(vector_changed, _mm256_xor_si256(v, word));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), v);
+        }
+        changed |= static_cast<uint64_t>(!_mm256_testz_si256(vector_changed, vector_changed));
+#endif
+        for (; i < n; ++i) {
+            changed |= grow_word(in, passable, out, n, i, q, b);
+        }
+        return changed != 0;
+    }
+
+    static uint64_t grow_word(const uint64_t* in, const uint64_t* passable, uint64_t* out,
+                              size_t n, size_t i, size_t q, size_t b) {
+        uint64_t word = in[i];
+        uint64_t v = word | (word << 1) | (word >> 1);
+        if (i > 0) {
+            v |= in[i - 1] >> 63;
+        }
+        if (i + 1 < n) {
+            v |= in[i + 1] << 63;
+        }
+        // shift by `stride` towards higher indices (the row below) and towards lower ones (the row above)
+        if (i >= q) {
+            v |= in[i - q] << b;
+            if (b != 0 && i >= q + 1) {
+                v |= in[i - q - 1] >> (64 - b);
+            }
+        }
+        if (i + q < n) {
+            v |= in[i + q] >> b;
+            if (b != 0 && i + q + 1 < n) {
+                v |= in[i + q + 1] << (64 - b);
+            }
+        }
+        out[i] = v & passable[i];
+        return out[i] ^ word;
+    }
+};
+
+HASH_SUPPORT(Bitboard)
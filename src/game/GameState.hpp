@@ -1,9 +1,8 @@
 #pragma once
 #include "Level.hpp"
 #include "Move.hpp"
-#include <unordered_set>
-#include <set>
-#include <functional>
+#include "Bitboard.hpp"
+#include <algorithm>
 #include <ranges>
 #include <utility>
 
@@ -12,62 +11,129 @@ struct PushableBox {
     std::vector<Move> allowed_moves;
 };
 
+// Box positions alone, as a board of occupied cells; the Zobrist key goes first so that different sets are almost
+// always told apart without looking at the boxes.
 struct ReducedState {
-    ReducedState(const std::unordered_set<Point>&  _boxes) : boxes(_boxes.begin(), _boxes.end()) {}
+    ReducedState(const Bitboard& _boxes, uint64_t _key) : key(_key), boxes(_boxes) {}
     bool operator==(const ReducedState& other) const {
-        return boxes == other.boxes;
+        return key == other.key && boxes == other.boxes;
     }
     size_t hash() const {
-        size_t r = 0;
-        for (Point box : boxes) {
-            r = hash_combine(r, box.hash());
-        }
-        return r;
+        return key;
     }
 private:
-    std::set<Point> boxes;
+    uint64_t key;
+    Bitboard boxes;
 };
 
 HASH_SUPPORT(ReducedState)
 
+// Box positions plus the top-left cell of the area the player can walk around in. The player can't tell apart
+// states which differ only by a position inside this area, so such states get equal keys.
+struct CanonicalState {
+    ReducedState boxes;
+    Point player;
+    uint64_t key;
+    bool operator==(const CanonicalState& other) const {
+        return key == other.key && player == other.player && boxes == other.boxes;
+    }
+    size_t hash() const {
+        return key;
+    }
+};
+
+HASH_SUPPORT(CanonicalState)
+
 class GameState {
 public:
     GameState(const Level& _level,
               Point _initial_player_position,
               const std::vector<Point>& _box_positions
-    ) : level(_level), player_position(_initial_player_position), boxes(_box_positions.begin(), _box_positions.end()) {}
+    ) : level(_level),
+        player_position(_initial_player_position),
+        box_cells(_level.cell_count()) {
+        for (Point box : _box_positions) {
+            if (!box_cells.test(level.index(box))) { // a box listed twice is still one box
+                boxes_key ^= level.box_key(box);
+                box_cells.set(level.index(box));
+            }
+        }
+    }
     GameState(const GameState& other) = default;
     GameState& operator=(const GameState& other) {
         player_position = other.player_position;
-        boxes = other.boxes;
+        box_cells = other.box_cells;
+        boxes_key = other.boxes_key;
+        return *this;
+    }
+    GameState(GameState&& other) noexcept = default;
+    GameState& operator=(GameState&& other) noexcept {
+        player_position = other.player_position;
+        box_cells = std::move(other.box_cells);
+        boxes_key = other.boxes_key;
         return *this;
     }
 
     void issue_order(Move move) {
-        // pick the cell that would've been visited if we performed the move
-        if (auto o_cell = level.next(player_position, move); o_cell) {
-            Cell cell = *o_cell;
-
-            bool move_allowed = cell.type != CellType::WALL;
-            if (is_box(cell)) {
-                // if this cell contains a crate we should also check whether it's possible to move the crate as well
-                if (auto o_next_for_box = level.next(cell.pos, move); o_next_for_box) {
-                    Cell next_for_box = *o_next_for_box;
-                    // move is allowed iff the box is not blocked by another box or a wall
-                    if (!is_box(next_for_box) && next_for_box.type != CellType::WALL) {
-                        move_box(cell.pos, next_for_box.pos);
-                    } else { // box cannot be pushed - don't move it and forbid initial player move as well
-                        move_allowed = false;
-                    }
-                } else { // box cannot be pushed out of level boundaries
-                    move_allowed = false;
-                }
+        if (move == Move::NONE) {
+            return;
+        }
+        // pick the cell that would've been visited if we performed the move; the level is walled all around
+        size_t cell = level.neighbour(level.index(player_position), move);
+        if (level.is_wall(cell)) {
+            return;
+        }
+        if (box_cells.test(cell)) {
+            // if this cell contains a crate we should also check whether it's possible to move the crate as well
+            size_t next_for_box = level.neighbour(cell, move);
+            // move is allowed iff the box is not blocked by another box or a wall
+            if (!is_walkable(next_for_box)) {
+                return; // box cannot be pushed - don't move it and forbid initial player move as well
             }
+            move_box(cell, next_for_box);
+        }
+        player_position = level.point(cell);
+    }
 
-            if (move_allowed) {
-                player_position = cell.pos;
-            }
+    // Reverse of a push: the player steps away from the crate right behind and drags it along.
+    // Returns false (and leaves the state untouched) if there is no such crate or the step is blocked.
+    bool issue_pull(Move move) {
+        if (move == Move::NONE) {
+            return false;
+        }
+        size_t player = level.index(player_position);
+        size_t cell = level.neighbour(player, move);
+        size_t crate = level.neighbour(player, opposite(move));
+        if (!is_walkable(cell) || !box_cells.test(crate)) {
+            return false;
         }
+        move_box(crate, player);
+        player_position = level.point(cell);
+        return true;
+    }
+
+    // What `unmake_push` needs to take a push back
+    struct PushUndo {
+        Point player;
+        size_t from;
+        size_t to;
+    };
+
+    // Puts the player behind `box` (the walk there isn't checked) and pushes the box `length` cells along `move`,
+    // the player following right behind it. Only the box and the player change, so the search can step into
+    // a successor and back without copying.
+    PushUndo make_push(Point box, Move move, size_t length = 1) {
+        size_t from = level.index(box);
+        size_t to = from + static_cast<std::ptrdiff_t>(length) * level.offset(move);
+        PushUndo undo{player_position, from, to};
+        move_box(from, to);
+        player_position = level.point(to - level.offset(move));
+        return undo;
+    }
+
+    void unmake_push(const PushUndo& undo) {
+        move_box(undo.to, undo.from);
+        player_position = undo.player;
     }
 
     void issue_orders(const std::vector<Move>& orders) {
@@ -79,81 +145,91 @@ public:
     std::vector<std::string> as_printable_strs() const {
         std::vector<std::string> level_strs = level.as_printable_strs();
         level_strs[player_position.x][player_position.y] = '@';
-        for (auto p : boxes) {
+        box_cells.for_each([&] (size_t i) {
+            Point p = level.point(i);
             level_strs[p.x][p.y] = 'x';
-        }
+        });
         return level_strs;
     }
 
     bool is_victory() const {
-        for (auto p : boxes) {
-            auto o_cell = level.at(p);
-            if (!o_cell || o_cell->type != CellType::TARGET) {
-                return false;
-            }
-        }
-        return true;
+        return box_cells.is_subset_of(level.targets());
     }
 
-    std::function<std::vector<Point>(Point)> f_adjacent_walkable() const {
-        return [this] (Point p) -> std::vector<Point> {
-            return adjacent_walkable(p);
+    // Cells the player may step on, as a functor of flat indices for `Paths::plot_path`
+    auto walkable() const {
+        return [this] (size_t index) -> bool {
+            return is_walkable(index);
         };
     }
 
-    std::vector<Point> adjacent_walkable(Point p) const {
+    // Boxes in cell order, built from the board on every call; the search itself works on `box_board()`
+    std::vector<Point> box_positions() const {
         std::vector<Point> result;
-        result.reserve(4);
-        for (const auto& probably_walkable : level.adjacent_walkable(p)) {
-            if (is_walkable(probably_walkable) && probably_walkable.pos != player_position) {
-                result.push_back(probably_walkable.pos);
-            }
-        }
+        result.reserve(box_cells.count());
+        box_cells.for_each([&] (size_t i) {
+            result.push_back(level.point(i));
+        });
         return result;
     }
 
-    const std::unordered_set<Point>& box_positions() const {
-        return boxes;
+    // Same boxes as a bitboard over `Level::index`
+    const Bitboard& box_board() const {
+        return box_cells;
+    }
+
+    bool has_box(size_t index) const {
+        return box_cells.test(index);
+    }
+
+    // Cells the player can walk to without pushing anything
+    Bitboard reachable() const {
+        Bitboard passable = level.floor();
+        passable.and_not(box_cells);
+        return Bitboard::flood_fill(level.index(player_position), passable, level.row_stride());
     }
 
     std::vector<PushableBox> all_pushable_boxes() const {
         std::vector<PushableBox> result;
-        result.reserve(boxes.size());
+        result.reserve(box_cells.count());
 
         std::vector<Move> move_buffer;
 
-        for (auto box : boxes) {
-            auto o_up = level.next(box, Move::W);
-            auto o_left = level.next(box, Move::A);
-            auto o_down = level.next(box, Move::S);
-            auto o_right = level.next(box, Move::D);
-
-            bool up = o_up && is_walkable(*o_up);
-            bool left = o_left && is_walkable(*o_left);
-            bool down = o_down && is_walkable(*o_down);
-            bool right = o_right && is_walkable(*o_right);
-
-            // it's very convenient to fail fast here if we have a crate stuck in a corner in a non-target cell
-            bool wall_up = !o_up || o_up->type == CellType::WALL;
-            bool wall_left = !o_left || o_left->type == CellType::WALL;
-            bool wall_down = !o_down || o_down->type == CellType::WALL;
-            bool wall_right = !o_right || o_right->type == CellType::WALL;
-
-            if (auto box_cell_type = level.at(box)->type; box_cell_type != CellType::TARGET) {
-                if (wall_up && wall_right || wall_right && wall_down || wall_down && wall_left || wall_left && wall_up) {
-                    return {}; // forbid all moves
-                }
+        // boxes go in cell order, which doesn't depend on how the state was reached
+        for (size_t i = box_cells.first(); i != Bitboard::NONE; i = box_cells.next(i)) {
+            Point box = level.point(i);
+            size_t i_up = level.neighbour(i, Move::W);
+            size_t i_left = level.neighbour(i, Move::A);
+            size_t i_down = level.neighbour(i, Move::S);
+            size_t i_right = level.neighbour(i, Move::D);
+
+            bool up = is_walkable(i_up);
+            bool left = is_walkable(i_left);
+            bool down = is_walkable(i_down);
+            bool right = is_walkable(i_right);
+
+            // it's very convenient to fail fast here if we have a crate on a dead cell (e.g. in a non-target corner)
+            if (level.is_dead(i)) {
+                return {}; // forbid all moves
             }
 
-            // otherwise continue gathering available moves around crates
+            // otherwise continue gathering available moves around crates, except the ones onto dead cells
             move_buffer.clear();
             if (up && down) {
-                move_buffer.push_back(Move::W);
-                move_buffer.push_back(Move::S);
+                if (!level.is_dead(i_up)) {
+                    move_buffer.push_back(Move::W);
+                }
+                if (!level.is_dead(i_down)) {
+                    move_buffer.push_back(Move::S);
+                }
             }
             if (left && right) {
-                move_buffer.push_back(Move::A);
-                move_buffer.push_back(Move::D);
+                if (!level.is_dead(i_left)) {
+                    move_buffer.push_back(Move::A);
+                }
+                if (!level.is_dead(i_right)) {
+                    move_buffer.push_back(Move::D);
+                }
             }
             if (!move_buffer.empty()) {
                 result.push_back(PushableBox{box, move_buffer});
@@ -168,52 +244,67 @@ public:
     }
 
     size_t hash() const {
-        std::vector<size_t> hashes;
-        hashes.reserve(boxes.size());
-
-        for (Point box : boxes) {
-            hashes.push_back(std::hash<Point>()(box));
-        }
-
-        std::sort(hashes.begin(), hashes.end());
+        return boxes_key ^ level.player_key(player_position);
+    }
 
-        size_t r = hash_combine(0, std::hash<Point>()(player_position));
-        for (size_t h : hashes) {
-            r = hash_combine(r, h);
-        }
-        return r;
+    // Zobrist key of the box positions alone, kept up to date on every push
+    uint64_t box_key() const {
+        return boxes_key;
     }
 
     bool operator==(const GameState& other) const {
-        return player_position == other.player_position && boxes == other.boxes;
+        return boxes_key == other.boxes_key && player_position == other.player_position && box_cells == other.box_cells;
     }
 
     ReducedState reduced_state() const {
-        return ReducedState(boxes);
+        return ReducedState(box_cells, boxes_key);
+    }
+
+    // Smallest (top-left) cell the player can reach without pushing anything
+    Point canonical_player_pos() const {
+        return canonical_player_pos(reachable());
+    }
+
+    // Same, from the player's area when it's already known, which spares a flood fill
+    Point canonical_player_pos(const Bitboard& reachable) const {
+        // flat indices grow row by row, so the lowest reachable index is the top-left cell
+        return level.point(reachable.first());
+    }
+
+    CanonicalState canonical_state() const {
+        Point player = canonical_player_pos();
+        return CanonicalState{reduced_state(), player, canonical_hash(player)};
+    }
+
+    // Same as `canonical_state().hash()` without copying the boxes
+    uint64_t canonical_hash() const {
+        return canonical_hash(canonical_player_pos());
+    }
+
+    uint64_t canonical_hash(Point canonical_player) const {
+        return boxes_key ^ level.player_key(canonical_player);
+    }
+
+    // Memory the state owns beyond `sizeof(GameState)`, i.e. the box board of a large level
+    size_t allocated_bytes() const {
+        return box_cells.heap_bytes();
     }
 
     size_t count_boxes_on_target() const {
-        size_t count = 0;
-        for (auto box : boxes) {
-            if (auto o_cell = level.at(box); o_cell && o_cell->type == CellType::TARGET) {
-                ++count;
-            }
-        }
-        return count;
+        return box_cells.count_common(level.targets());
     }
 private:
     const Level& level;
     Point player_position;
-    std::unordered_set<Point> boxes;
-    bool is_box(Cell p) const {
-        return boxes.contains(p.pos);
-    }
-    bool is_walkable(Cell c) const {
-        return c.type != CellType::WALL && !is_box(c);
+    Bitboard box_cells;
+    uint64_t boxes_key = 0;
+    bool is_walkable(size_t index) const {
+        return !level.is_wall(index) && !box_cells.test(index);
     }
-    void move_box(Point from, Point to) {
-        boxes.erase(from);
-        boxes.insert(to);
+    void move_box(size_t from, size_t to) {
+        box_cells.reset(from);
+        box_cells.set(to);
+        boxes_key ^= level.box_key(from) ^ level.box_key(to);
     }
 };
 
@@ -2,46 +2,85 @@
 #include "Cell.hpp"
 #include "Point.hpp"
 #include "Move.hpp"
+#include "Bitboard.hpp"
 
 #include <vector>
+#include <array>
 #include <string>
 #include <stdexcept>
 #include <optional>
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+#include <algorithm>
+#include <mutex>
 
+// The layout is kept as one contiguous array of cell types surrounded by a ring of sentinel walls. Cells are
+// addressed by flat indices and neighbours are found by adding `offset(move)`, so stepping off the map always
+// lands on a wall instead of requiring a bounds check.
 class Level {
 public:
     Level(const Level& other) = delete;
     Level(const Level&& other) = delete;
-    Level(const std::vector<std::string>& _strs) : strs(_strs) {}
+    Level(const std::vector<std::string>& _strs)
+            : strs(_strs), rows(_strs.size()), columns(_strs[0].length()), stride(columns + 2) {
+        cells.assign((rows + 2) * stride, static_cast<uint8_t>(CellType::WALL));
+        for (size_t x = 0; x < rows; ++x) {
+            for (size_t y = 0; y < columns; ++y) {
+                char c = y < strs[x].length() ? strs[x][y] : ' ';
+                cells[index(Point{x, y})] = static_cast<uint8_t>(from_char(c));
+            }
+        }
+        offsets = {0, -static_cast<std::ptrdiff_t>(stride), -1, static_cast<std::ptrdiff_t>(stride), 1};
+        floor_cells = Bitboard(cells.size());
+        target_cells = Bitboard(cells.size());
+        for (size_t i = 0; i < cells.size(); ++i) {
+            if (!is_wall(i)) {
+                floor_cells.set(i);
+            }
+            if (is_target(i)) {
+                target_cells.set(i);
+            }
+        }
+
+        // Zobrist keys: a state hash is the xor of the keys of its occupied cells, so a push only has to xor
+        // the box out of one cell and into another
+        box_keys.reserve(cells.size());
+        player_keys.reserve(cells.size());
+        for (size_t i = 0; i < cells.size(); ++i) {
+            box_keys.push_back(mix_hash(2 * i));
+            player_keys.push_back(mix_hash(2 * i + 1));
+        }
+        number_interior();
+        find_dead_cells();
+        find_tunnels();
+        find_goal_rooms();
+    }
 
     std::optional<Cell> next(Point p, Move move) const {
-        switch (move) {
-            case Move::W:
-                return at(p.x - 1, p.y);
-            case Move::A:
-                return at(p.x, p.y - 1);
-            case Move::S:
-                return at(p.x + 1, p.y);
-            case Move::D:
-                return at(p.x, p.y + 1);
-            default:
-                return std::nullopt;
+        if (move == Move::NONE) {
+            return std::nullopt;
         }
+        return at(p.move(move));
     }
 
     std::vector<Cell> adjacent_walkable(Point p) const {
         std::vector<Cell> result;
         result.reserve(MOVES.size());
+        size_t i = index(p);
         for (auto move : MOVES) {
-            if (auto o_next = next(p, move); o_next && o_next->type != CellType::WALL) {
-                result.push_back(*o_next);
+            if (size_t next = neighbour(i, move); !is_wall(next)) {
+                result.push_back(Cell{type(next), point(next)});
             }
         }
         return result;
     }
 
     std::optional<Cell> at(Point p) const {
-        return at(p.x, p.y);
+        if (p.x >= rows || p.y >= columns) {
+            return std::nullopt;
+        }
+        return Cell{type(index(p)), p};
     }
 
     const std::vector<std::string>& as_printable_strs() const {
@@ -49,17 +88,336 @@ public:
     }
 
     Point dimensions() const {
-        return Point{ strs.size(), strs[0].length() };
+        return Point{rows, columns};
+    }
+
+    // Flat index of a cell. Points one step outside of the map (including the wrapped around `0 - 1`) map to
+    // the sentinel walls.
+    size_t index(Point p) const {
+        return (p.x + 1) * stride + (p.y + 1);
+    }
+
+    Point point(size_t index) const {
+        return Point{index / stride - 1, index % stride - 1};
+    }
+
+    // Amount of flat indices, sentinels included
+    size_t cell_count() const {
+        return cells.size();
+    }
+
+    size_t neighbour(size_t index, Move move) const {
+        return index + offsets[static_cast<size_t>(move)];
+    }
+
+    std::ptrdiff_t offset(Move move) const {
+        return offsets[static_cast<size_t>(move)];
+    }
+
+    CellType type(size_t index) const {
+        return static_cast<CellType>(cells[index]);
+    }
+
+    bool is_wall(size_t index) const {
+        return cells[index] == static_cast<uint8_t>(CellType::WALL);
+    }
+
+    bool is_target(size_t index) const {
+        return cells[index] == static_cast<uint8_t>(CellType::TARGET);
+    }
+
+    // Distance between vertically adjacent cells in flat indices
+    size_t row_stride() const {
+        return stride;
+    }
+
+    // Cells of the smallest specialised bitboard kernel the level fits into (64, 128 or 256),
+    // 0 if it takes the generic one
+    size_t board_capacity() const {
+        for (size_t capacity : {64, 128, 256}) {
+            if (cells.size() <= capacity) {
+                return capacity;
+            }
+        }
+        return 0;
+    }
+
+    // Every cell that isn't a wall; never includes the sentinel ring
+    const Bitboard& floor() const {
+        return floor_cells;
+    }
+
+    const Bitboard& targets() const {
+        return target_cells;
+    }
+
+    // Floor cells from which a box can never reach any target, even with no other boxes around.
+    // A box pushed onto one of them is a deadlock.
+    const Bitboard& dead() const {
+        return dead_cells;
+    }
+
+    bool is_dead(size_t index) const {
+        return dead_cells.test(index);
+    }
+
+    // Whether the cell has walls on both sides across the direction of `move`, so that whatever stands there
+    // can only go along it
+    bool is_tunnel(size_t index, Move move) const {
+        return tunnel_cells[axis(move)].test(index);
+    }
+
+    // Whether the cell is the only way into a goal room, an area holding targets, which lies the `move` side of it
+    bool enters_goal_room(size_t index, Move move) const {
+        return room_entrances[static_cast<size_t>(move)].test(index);
+    }
+
+    uint64_t box_key(Point p) const {
+        return box_keys[index(p)];
+    }
+
+    uint64_t box_key(size_t index) const {
+        return box_keys[index];
+    }
+
+    // Key of the player standing at the given cell, or of the whole area when given its canonical cell
+    uint64_t player_key(Point p) const {
+        return player_keys[index(p)];
+    }
+
+    // Dense number of a cell enclosed by walls, NO_INDEX for walls and the floor outside of them.
+    // Only these cells can ever hold a box or the player.
+    uint32_t interior_index(Point p) const {
+        return interior[index(p)];
     }
+
+    uint32_t interior_index(size_t index) const {
+        return interior[index];
+    }
+
+    size_t interior_cells() const {
+        return interior_count;
+    }
+
+    // Length of the shortest walk between two cells when walls are the only obstacles, UNREACHABLE if walls separate
+    // them. Exact on levels with up to ALL_PAIRS_LIMIT floor cells, a lower bound from landmark distances (ALT)
+    // on larger ones. Boxes only make walks longer, so either way it never overestimates. The tables are computed
+    // by the first query, so levels that are only played never pay for them.
+    size_t walk_distance(size_t from, size_t to) const {
+        std::call_once(walks_computed, [this] { precompute_walk_distances(); });
+        uint32_t a = floor_number[from];
+        uint32_t b = floor_number[to];
+        if (a == NO_INDEX || b == NO_INDEX) {
+            return UNREACHABLE;
+        }
+        if (landmarks == 0) {
+            uint16_t distance = walk_distances[a * floor_count + b];
+            return distance == FAR ? UNREACHABLE : distance;
+        }
+        size_t bound = 0;
+        for (size_t l = 0; l < landmarks; ++l) {
+            size_t to_a = walk_distances[l * floor_count + a];
+            size_t to_b = walk_distances[l * floor_count + b];
+            if (to_a == FAR || to_b == FAR) {
+                if (to_a != to_b) {
+                    return UNREACHABLE; // only one of the cells shares an area with the landmark
+                }
+                continue;
+            }
+            bound = std::max(bound, to_a > to_b ? to_a - to_b : to_b - to_a); // triangle inequality
+        }
+        return bound;
+    }
+
+    bool exact_walk_distances() const {
+        std::call_once(walks_computed, [this] { precompute_walk_distances(); });
+        return landmarks == 0;
+    }
+
+    static constexpr size_t ALL_PAIRS_LIMIT = 1024; // 2 MB of distances
+    static constexpr size_t LANDMARKS = 16;
+    static constexpr size_t UNREACHABLE = std::numeric_limits<size_t>::max();
+    static constexpr uint32_t NO_INDEX = std::numeric_limits<uint32_t>::max();
+    static constexpr std::array<Move, 4> MOVES = { Move::W, Move::A, Move::S, Move::D };
 private:
-    static constexpr auto MOVES = { Move::W, Move::A, Move::S, Move::D };
     std::vector<std::string> strs;
+    size_t rows;
+    size_t columns;
+    size_t stride; // row length including both sentinel columns
+    std::vector<uint8_t> cells;
+    std::array<std::ptrdiff_t, 5> offsets{}; // indexed by Move, NONE stays in place
+    Bitboard floor_cells;
+    Bitboard target_cells;
+    Bitboard dead_cells;
+    std::array<Bitboard, 2> tunnel_cells;   // vertical, then horizontal
+    std::array<Bitboard, 5> room_entrances; // indexed by Move, the direction into the room
+    std::vector<uint64_t> box_keys;
+    std::vector<uint64_t> player_keys;
+    std::vector<uint32_t> interior;
+    size_t interior_count = 0;
+    mutable std::once_flag walks_computed;        // guards the walk tables below, filled by the first query
+    mutable std::vector<uint32_t> floor_number;   // dense number of every cell that isn't a wall, NO_INDEX for walls
+    mutable size_t floor_count = 0;
+    mutable std::vector<uint16_t> walk_distances; // rows of `floor_count`: one per floor cell, or one per landmark
+    mutable size_t landmarks = 0;                 // 0 if the table holds all pairs
 
-    std::optional<Cell> at(size_t i, size_t j) const {
-        if (i >= strs.size() || j >= strs[0].length()) {
-            return std::nullopt;
+    static constexpr uint16_t FAR = std::numeric_limits<uint16_t>::max(); // unreachable; longer walks saturate below it
+
+    void number_interior() {
+        // the floor connected to the sentinel ring is outside, everything else that isn't a wall is inside
+        interior.assign(cells.size(), NO_INDEX);
+        std::vector<bool> outside(cells.size(), false);
+        std::vector<size_t> stack;
+        for (size_t x = 0; x < rows; ++x) {
+            for (size_t y = 0; y < columns; ++y) {
+                bool border = x == 0 || y == 0 || x + 1 == rows || y + 1 == columns;
+                if (size_t i = index(Point{x, y}); border && !is_wall(i)) {
+                    outside[i] = true;
+                    stack.push_back(i);
+                }
+            }
+        }
+        while (!stack.empty()) {
+            size_t current = stack.back();
+            stack.pop_back();
+            for (Move move : MOVES) {
+                if (size_t next = neighbour(current, move); !is_wall(next) && !outside[next]) {
+                    outside[next] = true;
+                    stack.push_back(next);
+                }
+            }
+        }
+        for (size_t i = 0; i < cells.size(); ++i) {
+            if (!outside[i] && !is_wall(i)) {
+                interior[i] = static_cast<uint32_t>(interior_count++);
+            }
+        }
+    }
+
+    void find_dead_cells() {
+        // Pull boxes backwards from all targets at once: a box could have come to `current` from `prev` only if
+        // the player was able to stand behind it, i.e. the cell past `prev` is not a wall. Whatever no pull reaches is dead.
+        Bitboard alive(cells.size());
+        std::vector<size_t> queue;
+        for (size_t i = 0; i < cells.size(); ++i) {
+            if (is_target(i)) {
+                alive.set(i);
+                queue.push_back(i);
+            }
+        }
+        for (size_t head = 0; head < queue.size(); ++head) {
+            size_t current = queue[head];
+            for (Move move : MOVES) {
+                size_t prev = neighbour(current, move);
+                if (is_wall(prev) || alive.test(prev) || is_wall(neighbour(prev, move))) {
+                    continue;
+                }
+                alive.set(prev);
+                queue.push_back(prev);
+            }
+        }
+        dead_cells = floor_cells;
+        dead_cells.and_not(alive);
+    }
+
+    static size_t axis(Move move) {
+        return move == Move::W || move == Move::S ? 0 : 1;
+    }
+
+    void find_tunnels() {
+        for (Move move : {Move::W, Move::A}) {
+            Bitboard& tunnel = tunnel_cells[axis(move)];
+            tunnel = Bitboard(cells.size());
+            Move side = move == Move::W ? Move::A : Move::W;
+            for (size_t i = 0; i < cells.size(); ++i) {
+                if (!is_wall(i) && is_wall(neighbour(i, side)) && is_wall(neighbour(i, opposite(side)))) {
+                    tunnel.set(i);
+                }
+            }
+        }
+    }
+
+    void find_goal_rooms() {
+        // A doorway cell splits the floor in two if nothing but itself connects its sides. The side holding targets
+        // is a goal room, unless it's the larger one: then it's the rest of the level rather than a room.
+        for (Bitboard& entrances : room_entrances) {
+            entrances = Bitboard(cells.size());
+        }
+        for (size_t i = 0; i < cells.size(); ++i) {
+            if (interior[i] == NO_INDEX) {
+                continue;
+            }
+            for (Move move : MOVES) {
+                size_t inside = neighbour(i, move);
+                size_t outside = neighbour(i, opposite(move));
+                if (!is_tunnel(i, move) || is_wall(inside) || is_wall(outside)) {
+                    continue;
+                }
+                Bitboard passable = floor_cells;
+                passable.reset(i);
+                Bitboard room = Bitboard::flood_fill(inside, passable, stride);
+                if (room.test(outside) || room.count_common(target_cells) == 0) {
+                    continue;
+                }
+                Bitboard rest = Bitboard::flood_fill(outside, passable, stride);
+                if (room.count() <= rest.count()) {
+                    room_entrances[static_cast<size_t>(move)].set(i);
+                }
+            }
+        }
+    }
+
+    void precompute_walk_distances() const {
+        floor_number.assign(cells.size(), NO_INDEX);
+        std::vector<size_t> floor_cells_list;
+        for (size_t i = 0; i < cells.size(); ++i) {
+            if (!is_wall(i)) {
+                floor_number[i] = static_cast<uint32_t>(floor_count++);
+                floor_cells_list.push_back(i);
+            }
+        }
+        if (floor_count <= ALL_PAIRS_LIMIT) {
+            walk_distances.resize(floor_count * floor_count);
+            for (size_t n = 0; n < floor_count; ++n) {
+                walks_from(floor_cells_list[n], walk_distances.data() + n * floor_count);
+            }
+            return;
+        }
+
+        // Landmarks are picked one by one as the cell farthest from all picked so far, so they end up on the outskirts
+        // of the level (where the bounds are tight) and every separate area gets one before any area gets a second.
+        landmarks = std::min(LANDMARKS, floor_count);
+        walk_distances.resize(landmarks * floor_count);
+        std::vector<uint16_t> nearest(floor_count, FAR);
+        size_t next = 0;
+        for (size_t l = 0; l < landmarks; ++l) {
+            uint16_t* row = walk_distances.data() + l * floor_count;
+            walks_from(floor_cells_list[next], row);
+            for (size_t n = 0; n < floor_count; ++n) {
+                nearest[n] = std::min(nearest[n], row[n]);
+            }
+            next = static_cast<size_t>(std::max_element(nearest.begin(), nearest.end()) - nearest.begin());
+        }
+    }
+
+    // Breadth-first walk distances from `start` to every floor cell, indexed by floor number
+    void walks_from(size_t start, uint16_t* distances) const {
+        std::fill(distances, distances + floor_count, FAR);
+        std::vector<size_t> queue;
+        queue.reserve(floor_count);
+        distances[floor_number[start]] = 0;
+        queue.push_back(start);
+        for (size_t head = 0; head < queue.size(); ++head) {
+            size_t current = queue[head];
+            uint16_t distance = distances[floor_number[current]];
+            for (Move move : MOVES) {
+                size_t next = neighbour(current, move);
+                if (!is_wall(next) && distances[floor_number[next]] == FAR) {
+                    distances[floor_number[next]] = static_cast<uint16_t>(std::min<size_t>(distance + 1, FAR - 1));
+                    queue.push_back(next);
+                }
+            }
         }
-        return std::optional<Cell>(Cell { from_char(strs[i][j]), Point{i, j} });
     }
 
     static constexpr CellType from_char(char c) {
@@ -67,6 +425,4 @@ private:
         if (c == '.') return CellType::TARGET;
         return CellType::NONE;
     }
-};
-
-
+};
\ No newline at end of file
@@ -19,4 +19,19 @@ Move move_of(int c) {
         return Move::D;
     }
     return Move::NONE;
+}
+
+constexpr Move opposite(Move move) {
+    switch (move) {
+        case Move::W:
+            return Move::S;
+        case Move::A:
+            return Move::D;
+        case Move::S:
+            return Move::W;
+        case Move::D:
+            return Move::A;
+        default:
+            return Move::NONE;
+    }
 }
\ No newline at end of file
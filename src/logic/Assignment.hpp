@@ -0,0 +1,106 @@
+#pragma once
+#include "../game/Level.hpp"
+#include "../game/GameState.hpp"
+#include "Heuristic.hpp"
+
+#include <vector>
+#include <atomic>
+#include <limits>
+#include <cstdint>
+
+// Tells whether every box can still be given a target of its own which it can be pushed to, other boxes ignored
+// (a maximum matching of the bipartite box-target graph). It fails e.g. for two boxes that can only reach the same
+// target, or for a room holding more boxes than targets. The matching found last is kept per thread and the next
+// query starts from it: boxes that stayed in their cells keep their targets, so after a single push usually only
+// the moved box has to look for an augmenting path.
+class TargetAssignment {
+public:
+    TargetAssignment(const Level& _level, const Heuristic& heuristic)
+            : level(_level), target_count(heuristic.target_positions().size()), reachable(_level.cell_count()),
+              id(next_id++) {
+        for (size_t i = 0; i < level.cell_count(); ++i) {
+            if (level.is_wall(i)) {
+                continue;
+            }
+            for (size_t target = 0; target < target_count; ++target) {
+                if (heuristic.can_reach(level.point(i), target)) {
+                    reachable[i].push_back(static_cast<uint32_t>(target));
+                }
+            }
+        }
+    }
+
+    bool assignable(const GameState& state) const {
+        const Bitboard& boxes = state.box_board();
+        if (boxes.count() > target_count) {
+            return false;
+        }
+        Scratch& scratch = get();
+
+        // targets of the cells boxes have left are free again, boxes that stayed keep theirs
+        for (uint32_t& cell : scratch.owner) {
+            if (cell != NONE && !boxes.test(cell)) {
+                scratch.target_of[cell] = NONE;
+                cell = NONE;
+            }
+        }
+        for (size_t i = boxes.first(); i != Bitboard::NONE; i = boxes.next(i)) {
+            if (scratch.target_of[i] != NONE) {
+                continue;
+            }
+            if (++scratch.generation == 0) {
+                std::fill(scratch.stamps.begin(), scratch.stamps.end(), 0);
+                scratch.generation = 1;
+            }
+            if (!augment(scratch, static_cast<uint32_t>(i))) {
+                return false; // the matching stays valid for the boxes assigned so far
+            }
+        }
+        return true;
+    }
+private:
+    static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+    static inline std::atomic<uint64_t> next_id = 1;
+
+    const Level& level;
+    size_t target_count;
+    std::vector<std::vector<uint32_t>> reachable; // per cell, targets a box there can be pushed to
+    uint64_t id;                                  // tells the scratch which assignment it was left by
+
+    struct Scratch {
+        uint64_t assignment = 0;
+        std::vector<uint32_t> target_of; // per cell, the target of the box standing there
+        std::vector<uint32_t> owner;     // per target, the cell of the box it's given to
+        std::vector<uint32_t> stamps;    // per target, the generation of the search that visited it last
+        uint32_t generation = 0;
+    };
+
+    Scratch& get() const {
+        // kept per thread, so several searches may check their states at the same time
+        static thread_local Scratch scratch;
+        if (scratch.assignment != id) {
+            scratch.assignment = id;
+            scratch.target_of.assign(level.cell_count(), NONE);
+            scratch.owner.assign(target_count, NONE);
+            scratch.stamps.assign(target_count, 0);
+            scratch.generation = 0;
+        }
+        return scratch;
+    }
+
+    // Kuhn's augmenting path: takes a free target, or one whose box can move on to another target
+    bool augment(Scratch& scratch, uint32_t cell) const {
+        for (uint32_t target : reachable[cell]) {
+            if (scratch.stamps[target] == scratch.generation) {
+                continue;
+            }
+            scratch.stamps[target] = scratch.generation;
+            if (scratch.owner[target] == NONE || augment(scratch, scratch.owner[target])) {
+                scratch.owner[target] = cell;
+                scratch.target_of[cell] = target;
+                return true;
+            }
+        }
+        return false;
+    }
+};
@@ -0,0 +1,83 @@
+#pragma once
+#include "Concurrent.hpp"
+
+#include <chrono>
+#include <optional>
+#include <atomic>
+#include <limits>
+
+// Limits of a single search. Everything is unlimited by default.
+struct SearchBudget {
+    static constexpr size_t UNLIMITED = std::numeric_limits<size_t>::max();
+
+    std::optional<std::chrono::steady_clock::time_point> deadline = std::nullopt;
+    size_t max_expanded_nodes = UNLIMITED;
+    size_t max_table_bytes = UNLIMITED; // estimated memory of stored and queued states, search nodes and frames
+    CancellationToken cancellation;
+
+    static SearchBudget within(std::chrono::steady_clock::duration timeout) {
+        SearchBudget budget;
+        budget.deadline = std::chrono::steady_clock::now() + timeout;
+        return budget;
+    }
+};
+
+// Spends a budget during the search. Charging is thread-safe and cheap enough to happen on every expansion:
+// a relaxed counter increment, and the clock is only read once per CLOCK_PERIOD expansions.
+class BudgetTracker {
+public:
+    void reset(const SearchBudget& _budget) {
+        budget = _budget;
+        expanded.store(0, std::memory_order_relaxed);
+        table_bytes.store(0, std::memory_order_relaxed);
+        exhausted.store(false, std::memory_order_relaxed);
+    }
+
+    // Returns false once the search has to stop
+    bool charge_expansion() {
+        size_t count = expanded.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (count > budget.max_expanded_nodes
+            || table_bytes.load(std::memory_order_relaxed) > budget.max_table_bytes
+            || (budget.deadline && count % CLOCK_PERIOD == 1 && std::chrono::steady_clock::now() >= *budget.deadline)) {
+            exhausted.store(true, std::memory_order_relaxed);
+        }
+        return !is_exhausted();
+    }
+
+    // For work that isn't counted in expansions, e.g. per-level tables built before the search. Reads the clock
+    // on every call, so it's meant for steps much longer than an expansion.
+    bool check_deadline() {
+        if (budget.deadline && std::chrono::steady_clock::now() >= *budget.deadline) {
+            exhausted.store(true, std::memory_order_relaxed);
+        }
+        return !is_exhausted();
+    }
+
+    void charge_table(size_t bytes) {
+        table_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    // Gives back what was charged for an entry that left the search, e.g. a state popped from an open list
+    void release_table(size_t bytes) {
+        table_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+
+    // Cancellation counts as running out of budget
+    bool is_exhausted() const {
+        return exhausted.load(std::memory_order_relaxed) || budget.cancellation.is_cancelled();
+    }
+
+    size_t table_size() const {
+        return table_bytes.load(std::memory_order_relaxed);
+    }
+
+    size_t max_table_bytes() const {
+        return budget.max_table_bytes;
+    }
+private:
+    static constexpr size_t CLOCK_PERIOD = 64;
+    SearchBudget budget;
+    std::atomic<size_t> expanded = 0;
+    std::atomic<size_t> table_bytes = 0;
+    std::atomic<bool> exhausted = false;
+};
@@ -0,0 +1,142 @@
+#pragma once
+#include <mutex>
+#include <deque>
+#include <optional>
+#include <atomic>
+#include <memory>
+
+// Double-ended work queue of a single worker. The owner treats it as a stack (newest work first, which keeps its
+// own search depth-first and cache-friendly), while idle workers steal the oldest items from the opposite end:
+// those are closest to the root and tend to carry the largest subtrees.
+template <class T>
+class WorkStealingDeque {
+public:
+    void push(T item) {
+        std::lock_guard lock(mutex);
+        items.push_back(std::move(item));
+    }
+
+    std::optional<T> pop() {
+        std::lock_guard lock(mutex);
+        if (items.empty()) {
+            return std::nullopt;
+        }
+        std::optional<T> item(std::move(items.back()));
+        items.pop_back();
+        return item;
+    }
+
+    std::optional<T> steal() {
+        std::lock_guard lock(mutex);
+        if (items.empty()) {
+            return std::nullopt;
+        }
+        std::optional<T> item(std::move(items.front()));
+        items.pop_front();
+        return item;
+    }
+private:
+    std::mutex mutex;
+    std::deque<T> items;
+};
+
+// Table split into independently locked shards picked by key hash, so threads only contend when they
+// touch the same shard at the same time.
+template <class Table, size_t SHARDS = 64>
+class ShardedTable {
+public:
+    // every shard gets its own table constructed from the same arguments
+    template <class... Args>
+    explicit ShardedTable(const Args&... args) {
+        for (size_t i = 0; i < SHARDS; ++i) {
+            shards.emplace_back(args...);
+        }
+    }
+
+    template <class F>
+    auto with_shard(size_t hash, F&& f) {
+        Shard& shard = shards[hash % SHARDS];
+        std::lock_guard lock(shard.mutex);
+        return f(shard.table);
+    }
+private:
+    struct Shard {
+        template <class... Args>
+        explicit Shard(const Args&... args) : table(args...) {}
+        std::mutex mutex;
+        Table table;
+    };
+    std::deque<Shard> shards; // mutexes can't be moved, but a deque doesn't need to
+};
+
+// Lock-free multi-producer single-consumer queue. Producers prepend to an intrusive list with CAS,
+// the owner detaches the whole list at once. Items come out in no particular order.
+template <class T>
+class MpscQueue {
+public:
+    MpscQueue() = default;
+    MpscQueue(const MpscQueue& other) = delete;
+    ~MpscQueue() {
+        drain([] (T&&) {});
+    }
+
+    void push(T item) {
+        Node* node = new Node{std::move(item), head.load(std::memory_order_relaxed)};
+        while (!head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {
+            // `node->next` was refreshed by the failed exchange, just retry
+        }
+    }
+
+    // Must only be called by the owner. Returns amount of consumed items.
+    template <class F>
+    size_t drain(F&& f) {
+        Node* node = head.exchange(nullptr, std::memory_order_acquire);
+        size_t count = 0;
+        while (node) {
+            Node* next = node->next;
+            f(std::move(node->item));
+            delete node;
+            node = next;
+            ++count;
+        }
+        return count;
+    }
+private:
+    struct Node {
+        T item;
+        Node* next;
+    };
+    std::atomic<Node*> head = nullptr;
+};
+
+// Cooperative stop request. Copies share the flag: whoever holds one can stop the search, which checks it on
+// every expansion and returns as soon as it notices. A child token is also cancelled along with its parent.
+class CancellationToken {
+public:
+    CancellationToken() : state(std::make_shared<State>()) {}
+
+    void cancel() const {
+        state->flag.store(true, std::memory_order_relaxed);
+    }
+
+    bool is_cancelled() const {
+        for (const State* s = state.get(); s; s = s->parent.get()) {
+            if (s->flag.load(std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    CancellationToken child() const {
+        CancellationToken token;
+        token.state->parent = state;
+        return token;
+    }
+private:
+    struct State {
+        std::atomic<bool> flag = false;
+        std::shared_ptr<const State> parent;
+    };
+    std::shared_ptr<State> state;
+};
@@ -0,0 +1,184 @@
+#pragma once
+#include "../game/Level.hpp"
+#include "../game/GameState.hpp"
+
+#include <vector>
+#include <queue>
+#include <limits>
+#include <cstdint>
+
+class Heuristic {
+public:
+    static constexpr size_t DEADLOCK = std::numeric_limits<size_t>::max();
+
+    Heuristic(const Level& _level) : level(_level) {
+        for (size_t i = 0; i < level.cell_count(); ++i) {
+            if (level.is_target(i)) {
+                targets.push_back(level.point(i));
+            }
+        }
+        distances.reserve(targets.size());
+        for (Point target : targets) {
+            distances.push_back(pull_distances(target));
+        }
+    }
+
+    // Minimal amount of pushes required to bring the box from `box` to `targets()[target]`, other boxes ignored.
+    size_t push_distance(Point box, size_t target) const {
+        return distances[target][level.index(box)];
+    }
+
+    bool can_reach(Point box, size_t target) const {
+        return push_distance(box, target) != UNREACHABLE;
+    }
+
+    const std::vector<Point>& target_positions() const {
+        return targets;
+    }
+
+    // Admissible estimate of pushes left to win: every box is assigned to its own target so that the sum of push
+    // distances is minimal (Hungarian algorithm). Every push moves a single box by one cell, so it can't decrease this
+    // sum by more than one - the estimate is consistent as well. Returns DEADLOCK if boxes can't be matched at all.
+    // The matrix and the potentials live in per-thread scratch, so a call allocates nothing once it has grown.
+    size_t lower_bound(const GameState& state) const {
+        const Bitboard& boxes = state.box_board();
+        size_t n = boxes.count();
+        size_t m = targets.size();
+        if (n > m) {
+            return DEADLOCK;
+        }
+        if (n == 0) {
+            return 0;
+        }
+
+        // 1-indexed cost matrix, see https://cp-algorithms.com/graph/hungarian-algorithm.html
+        Scratch& scratch = get();
+        std::vector<int64_t>& cost = scratch.cost;
+        cost.assign((n + 1) * (m + 1), 0);
+        size_t i = 1;
+        for (size_t cell = boxes.first(); cell != Bitboard::NONE; cell = boxes.next(cell)) {
+            bool reachable = false;
+            for (size_t j = 1; j <= m; ++j) {
+                size_t distance = distances[j - 1][cell];
+                if (distance == UNREACHABLE) {
+                    cost[i * (m + 1) + j] = UNMATCHABLE_COST;
+                } else {
+                    cost[i * (m + 1) + j] = static_cast<int64_t>(distance);
+                    reachable = true;
+                }
+            }
+            if (!reachable) {
+                return DEADLOCK; // box can't be delivered anywhere
+            }
+            ++i;
+        }
+
+        std::vector<int64_t>& u = scratch.u;
+        std::vector<int64_t>& v = scratch.v;
+        std::vector<int64_t>& min_v = scratch.min_v;
+        std::vector<size_t>& p = scratch.p;
+        std::vector<size_t>& way = scratch.way;
+        std::vector<uint8_t>& used = scratch.used;
+        u.assign(n + 1, 0);
+        v.assign(m + 1, 0);
+        min_v.resize(m + 1);
+        p.assign(m + 1, 0);
+        way.assign(m + 1, 0);
+        used.resize(m + 1);
+        for (i = 1; i <= n; ++i) {
+            p[0] = i;
+            size_t j0 = 0;
+            std::fill(min_v.begin(), min_v.end(), INFINITE_COST);
+            std::fill(used.begin(), used.end(), 0);
+            do {
+                used[j0] = true;
+                size_t i0 = p[j0];
+                size_t j1 = 0;
+                int64_t delta = INFINITE_COST;
+                for (size_t j = 1; j <= m; ++j) {
+                    if (!used[j]) {
+                        int64_t current = cost[i0 * (m + 1) + j] - u[i0] - v[j];
+                        if (current < min_v[j]) {
+                            min_v[j] = current;
+                            way[j] = j0;
+                        }
+                        if (min_v[j] < delta) {
+                            delta = min_v[j];
+                            j1 = j;
+                        }
+                    }
+                }
+                for (size_t j = 0; j <= m; ++j) {
+                    if (used[j]) {
+                        u[p[j]] += delta;
+                        v[j] -= delta;
+                    } else {
+                        min_v[j] -= delta;
+                    }
+                }
+                j0 = j1;
+            } while (p[j0] != 0);
+            do {
+                size_t j1 = way[j0];
+                p[j0] = p[j1];
+                j0 = j1;
+            } while (j0 != 0);
+        }
+
+        int64_t total = -v[0];
+        if (total >= UNMATCHABLE_COST) {
+            return DEADLOCK; // some box had to take a target it can never reach
+        }
+        return static_cast<size_t>(total);
+    }
+private:
+    static constexpr size_t UNREACHABLE = std::numeric_limits<size_t>::max();
+    static constexpr int64_t UNMATCHABLE_COST = 1'000'000;
+    static constexpr int64_t INFINITE_COST = std::numeric_limits<int64_t>::max() / 4;
+
+    const Level& level;
+    std::vector<Point> targets;
+    std::vector<std::vector<size_t>> distances; // per target, indexed by `Level::index`
+
+    struct Scratch {
+        std::vector<int64_t> cost;
+        std::vector<int64_t> u;
+        std::vector<int64_t> v;
+        std::vector<int64_t> min_v;
+        std::vector<size_t> p;
+        std::vector<size_t> way;
+        std::vector<uint8_t> used; // not a vector<bool>, single bytes are cheaper to flip
+    };
+
+    static Scratch& get() {
+        // kept per thread, so several searches may estimate their states at the same time
+        static thread_local Scratch scratch;
+        return scratch;
+    }
+
+    std::vector<size_t> pull_distances(Point target) const {
+        // Walk backwards from the target: the box could have come to `current` from `prev` only if the player
+        // was able to stand behind it, i.e. both `prev` and the cell past `prev` are not walls.
+        std::vector<size_t> result(level.cell_count(), UNREACHABLE);
+        std::queue<size_t> queue;
+        result[level.index(target)] = 0;
+        queue.push(level.index(target));
+
+        while (!queue.empty()) {
+            size_t current = queue.front();
+            queue.pop();
+            for (Move move : Level::MOVES) {
+                size_t prev = level.neighbour(current, move);
+                if (level.is_wall(prev) || result[prev] != UNREACHABLE) {
+                    continue;
+                }
+                if (level.is_wall(level.neighbour(prev, move))) {
+                    continue; // no room for the player
+                }
+                result[prev] = result[current] + 1;
+                queue.push(prev);
+            }
+        }
+        return result;
+    }
+};
@@ -0,0 +1,129 @@
+#pragma once
+#include "../game/Level.hpp"
+#include "../game/GameState.hpp"
+#include "../util/Hash.hpp"
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <variant>
+#include <stdexcept>
+
+// Set of visited states (or a map when `Value` is given) which keeps every state in the same few 64-bit words:
+// a bit per interior cell of the level telling if it holds a box, followed by the 16-bit interior index of
+// the player's canonical cell, which names the area the player can walk around in. States are appended to one
+// contiguous arena and found through an open-addressing index of their numbers, so nothing is allocated per state.
+template <class Value = std::monostate>
+class PackedStates {
+public:
+    explicit PackedStates(const Level& _level)
+            : level(_level), words((_level.interior_cells() + REGION_BITS + 63) / 64), slots(MIN_SLOTS, EMPTY) {
+        if (level.interior_cells() > REGION_LIMIT) {
+            throw std::length_error("Level has too many cells for a 16-bit player region id");
+        }
+        packed.resize(words);
+    }
+
+    // Stores the state with the given value unless it's already there. Returns the stored value (valid until
+    // the next insertion) and whether the state is new.
+    std::pair<Value&, bool> try_emplace(const GameState& state, Value value) {
+        return try_emplace(state, state.canonical_player_pos(), std::move(value));
+    }
+
+    // Same, with the player's canonical cell found beforehand, e.g. from the reachability the search needs anyway
+    std::pair<Value&, bool> try_emplace(const GameState& state, Point canonical_player, Value value) {
+        pack(state, canonical_player);
+        uint64_t hash = hash_packed(packed.data());
+        size_t slot = hash & (slots.size() - 1);
+        for (; slots[slot] != EMPTY; slot = (slot + 1) & (slots.size() - 1)) {
+            if (std::memcmp(arena.data() + slots[slot] * words, packed.data(), words * sizeof(uint64_t)) == 0) {
+                return {values[slots[slot]], false};
+            }
+        }
+
+        slots[slot] = static_cast<uint32_t>(values.size());
+        arena.insert(arena.end(), packed.begin(), packed.end());
+        values.push_back(std::move(value));
+        if (values.size() * 2 > slots.size()) {
+            rehash(slots.size() * 2);
+        }
+        return {values.back(), true};
+    }
+
+    bool insert(const GameState& state) {
+        return try_emplace(state, Value{}).second;
+    }
+
+    bool insert(const GameState& state, Point canonical_player) {
+        return try_emplace(state, canonical_player, Value{}).second;
+    }
+
+    void reserve(size_t states) {
+        arena.reserve(states * words);
+        values.reserve(states);
+        size_t wanted = slots.size();
+        while (states * 2 > wanted) {
+            wanted *= 2;
+        }
+        if (wanted != slots.size()) {
+            rehash(wanted);
+        }
+    }
+
+    size_t size() const {
+        return values.size();
+    }
+
+    // Memory taken by one more state, counting index slots the table keeps at least half empty
+    size_t bytes_per_state() const {
+        return words * sizeof(uint64_t) + sizeof(Value) + 2 * sizeof(uint32_t);
+    }
+private:
+    static constexpr size_t REGION_BITS = 16;
+    static constexpr size_t REGION_LIMIT = size_t(1) << REGION_BITS;
+    static constexpr size_t MIN_SLOTS = 16;
+    static constexpr uint32_t EMPTY = std::numeric_limits<uint32_t>::max();
+
+    const Level& level;
+    size_t words;
+    std::vector<uint64_t> arena;  // `words` per state, in insertion order
+    std::vector<Value> values;    // parallel to the arena
+    std::vector<uint32_t> slots;  // state numbers, power-of-two sized
+    std::vector<uint64_t> packed; // scratch space for the state being looked up
+
+    void pack(const GameState& state, Point canonical_player) {
+        std::fill(packed.begin(), packed.end(), 0);
+        state.box_board().for_each([&] (size_t box) {
+            set_bits(level.interior_index(box), 1);
+        });
+        set_bits(level.interior_cells(), level.interior_index(canonical_player));
+    }
+
+    void set_bits(size_t offset, uint64_t bits) {
+        // `bits` is at most 16 bits long, so it spans two words at most
+        packed[offset / 64] |= bits << (offset % 64);
+        if (offset % 64 != 0 && offset / 64 + 1 < words) {
+            packed[offset / 64 + 1] |= bits >> (64 - offset % 64);
+        }
+    }
+
+    uint64_t hash_packed(const uint64_t* state) const {
+        uint64_t hash = 0;
+        for (size_t i = 0; i < words; ++i) {
+            hash = mix_hash(hash ^ state[i]);
+        }
+        return hash;
+    }
+
+    void rehash(size_t size) {
+        slots.assign(size, EMPTY);
+        for (size_t number = 0; number < values.size(); ++number) {
+            size_t slot = hash_packed(arena.data() + number * words) & (size - 1);
+            while (slots[slot] != EMPTY) {
+                slot = (slot + 1) & (size - 1);
+            }
+            slots[slot] = static_cast<uint32_t>(number);
+        }
+    }
+};
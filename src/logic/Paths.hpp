@@ -1,75 +1,66 @@
 #pragma once
-#include <queue>
+#include "../game/Level.hpp"
+#include "../game/GameState.hpp"
+
+#include <vector>
 #include <optional>
-#include <functional>
-#include <unordered_set>
-#include <list>
+#include <algorithm>
+#include <limits>
+#include <cstdint>
 
 struct Path {
-    Point goal;
-    std::vector<Point> points;
-
-    Path(Point _goal, Point p) : goal(_goal) {
-        points.push_back(p);
-    }
-
-    Path(Point _goal, const Path& path, Point p) : goal(_goal) {
-        points = path.points;
-        points.push_back(p);
-    }
-
-    bool operator<(const Path& other) const {
-        // inverse check due to c++ heap-queue behaviour
-        size_t my_dist = Point::distance(points.back(), goal);
-        size_t other_dist = Point::distance(other.points.back(), goal);
-        if (my_dist == other_dist) {
-            return points.size() > other.points.size();
-        }
-        return my_dist > other_dist;
-    }
+    std::vector<Point> points; // from the start to the goal, both included
 
     Point last() {
         return points.back();
     }
 };
 
-class PathQueue : public std::priority_queue<Path> {
-public:
-    void reserve(size_t amount) {
-        c.reserve(amount);
-    }
-    void clear() {
-        c.clear();
-        std::make_heap(c.begin(), c.end());
-    }
-};
-
+// A* search for a shortest walk, guided by the walk distances the level precomputed with walls as the only
+// obstacles. Those never overestimate, and on levels small enough for exact tables a walk that no box blocks
+// is found without exploring anything off it. Cells are flat level indices; the visited marks and parent links live
+// in per-thread arrays stamped with the number of the query, so nothing is cleared or allocated between queries,
+// except growing to a bigger level. The solver plots the walk before every push of a solution with it.
 class Paths {
 public:
-    static std::optional<Path> plot_path(Point start,
-                                         Point goal,
-                                         std::function<std::vector<Point>(Point)> adjacent_getter) {
-        std::unordered_set<Point>& visited = get().visited;
-        PathQueue& paths = get().paths;
-        visited.clear();
-        paths.clear();
-        paths.push(Path(goal, start));
-
-        while (!paths.empty()) {
-            Path best_path = paths.top();
-            paths.pop();
-
-            Point current = best_path.last();
-            auto [_, not_visited] = visited.insert(current);
-            if (not_visited) {
-                if (current == goal) {
-                    return best_path;
-                }
-
-                for (Point adjacent_pt : adjacent_getter(current)) {
-                    if (!visited.count(adjacent_pt)) {
-                        paths.push(Path(goal, best_path, adjacent_pt));
-                    }
+    // `passable(index)` tells whether the player may step on the cell, e.g. `GameState::walkable()`
+    template <class Passable>
+    static std::optional<Path> plot_path(const Level& level, Point start, Point goal, Passable&& passable) {
+        if (!level.at(start) || !level.at(goal)) {
+            return std::nullopt;
+        }
+        size_t start_index = level.index(start);
+        size_t goal_index = level.index(goal);
+        size_t estimate = level.walk_distance(start_index, goal_index);
+        if (estimate == Level::UNREACHABLE) {
+            return std::nullopt; // walls alone keep the goal away
+        }
+        Scratch& scratch = get(level.cell_count());
+        uint32_t generation = scratch.generation;
+        std::vector<Step>& queue = scratch.queue;
+        queue.clear();
+        queue.push_back(Step{estimate, 1, static_cast<uint32_t>(start_index), NO_PARENT});
+
+        while (!queue.empty()) {
+            std::pop_heap(queue.begin(), queue.end());
+            Step best = queue.back();
+            queue.pop_back();
+
+            if (scratch.stamps[best.cell] == generation) {
+                continue;
+            }
+            scratch.stamps[best.cell] = generation;
+            scratch.parents[best.cell] = best.parent;
+            if (best.cell == goal_index) {
+                return trace(level, scratch, best);
+            }
+            for (Move move : Level::MOVES) {
+                size_t next = level.neighbour(best.cell, move);
+                if (scratch.stamps[next] != generation && passable(next)) {
+                    // the walk so far has `best.length` steps once it enters `next`
+                    size_t total = best.length + level.walk_distance(next, goal_index);
+                    queue.push_back(Step{total, best.length + 1, static_cast<uint32_t>(next), best.cell});
+                    std::push_heap(queue.begin(), queue.end());
                 }
             }
         }
@@ -126,17 +117,52 @@ public:
         return as_string(as_moves(path));
     }
 private:
-    static constexpr size_t DEFAULT_CAPACITY = 1000;
-    std::unordered_set<Point> visited;
-    PathQueue paths;
-    static Paths& get() {
-        static Paths paths;
-        return paths;
+    static constexpr uint32_t NO_PARENT = std::numeric_limits<uint32_t>::max();
+
+    struct Step {
+        size_t total;  // steps so far plus the estimate of the rest
+        size_t length; // cells of the walk up to and including this one
+        uint32_t cell;
+        uint32_t parent;
+        bool operator<(const Step& other) const {
+            // inverse check due to c++ heap-queue behaviour; among equal totals the walk closer to the goal goes first
+            if (total == other.total) {
+                return length < other.length;
+            }
+            return total > other.total;
+        }
+    };
+
+    struct Scratch {
+        std::vector<uint32_t> stamps;  // per cell, the generation of the query that visited it last
+        std::vector<uint32_t> parents; // per cell, valid if visited by the current query
+        std::vector<Step> queue;
+        uint32_t generation = 0;
+    };
+
+    static Scratch& get(size_t cells) {
+        // scratch buffers are per thread, so several searches may plot paths at the same time
+        static thread_local Scratch scratch;
+        if (scratch.stamps.size() < cells) {
+            scratch.stamps.resize(cells, 0);
+            scratch.parents.resize(cells);
+            scratch.queue.reserve(cells * Level::MOVES.size());
+        }
+        if (++scratch.generation == 0) { // stamps of 4 billion queries ago would look fresh again
+            std::fill(scratch.stamps.begin(), scratch.stamps.end(), 0);
+            scratch.generation = 1;
+        }
+        return scratch;
     }
 
-    Paths() {
-        visited.reserve(DEFAULT_CAPACITY);
-        paths.reserve(DEFAULT_CAPACITY);
+    static Path trace(const Level& level, const Scratch& scratch, const Step& goal) {
+        Path path;
+        path.points.resize(goal.length);
+        uint32_t cell = goal.cell;
+        for (size_t i = goal.length; i-- > 0; cell = scratch.parents[cell]) {
+            path.points[i] = level.point(cell);
+        }
+        return path;
     }
 
     static Move move_between(Point p1, Point p2) {
@@ -0,0 +1,171 @@
+#pragma once
+#include "../game/Level.hpp"
+#include "../game/Bitboard.hpp"
+
+#include <vector>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <array>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+// Sets of box cells proven to be a deadlock wherever the player stands, whatever the other boxes are. A state
+// holding all boxes of any stored pattern is dead. Every pattern is filed under its lowest cell, so a lookup only
+// compares the patterns anchored at the cells holding boxes. Lookups share a lock and never wait for each other,
+// patterns are rare and are added under an exclusive one.
+class DeadlockPatterns {
+public:
+    explicit DeadlockPatterns(const Level& level) : by_anchor(level.cell_count()) {}
+
+    bool matches(const Bitboard& boxes) const {
+        if (count.load(std::memory_order_relaxed) == 0) {
+            return false; // nothing learned yet, not even worth the lock
+        }
+        std::shared_lock lock(mutex);
+        for (size_t i = boxes.first(); i != Bitboard::NONE; i = boxes.next(i)) {
+            for (const Bitboard& pattern : by_anchor[i]) {
+                if (pattern.is_subset_of(boxes)) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // Returns false if the pattern was already covered by a stored one, e.g. learned by another thread meanwhile
+    bool add(const Bitboard& pattern) {
+        std::unique_lock lock(mutex);
+        for (size_t i = pattern.first(); i != Bitboard::NONE; i = pattern.next(i)) {
+            for (const Bitboard& known : by_anchor[i]) {
+                if (known.is_subset_of(pattern)) {
+                    return false;
+                }
+            }
+        }
+        by_anchor[pattern.first()].push_back(pattern);
+        count.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    size_t size() const {
+        return count.load(std::memory_order_relaxed);
+    }
+
+    template <class F>
+    void for_each(F&& f) const {
+        std::shared_lock lock(mutex);
+        for (const auto& anchored : by_anchor) {
+            for (const Bitboard& pattern : anchored) {
+                f(pattern);
+            }
+        }
+    }
+private:
+    mutable std::shared_mutex mutex;
+    std::vector<std::vector<Bitboard>> by_anchor; // per cell, the patterns whose lowest cell it is
+    std::atomic<size_t> count = 0;
+};
+
+// Placements of two or three boxes in a small window which are dead wherever the player stands. A placement is a shape
+// (two touching cells, or three cells in a straight or bent line) put at its lowest cell, the anchor. Every pair of
+// an anchor and a shape has its own verdict, so a placement is looked up with a single load. Verdicts are decided
+// lazily, the first time a search pushes a box into the placement, and kept for every later search of the level.
+// Searches on other threads (e.g. the racers of a portfolio) may share the table and decide placements at once.
+class DeadlockTable {
+public:
+    enum Verdict : uint8_t {
+        UNDECIDED,
+        ALIVE,
+        DEAD
+    };
+
+    struct Shape {
+        size_t boxes;
+        std::array<std::ptrdiff_t, 3> offsets; // flat offsets of the boxes from the anchor, the anchor's own first
+    };
+    static constexpr size_t SHAPE_COUNT = 10;
+
+    explicit DeadlockTable(const Level& level) : verdicts(level.cell_count() * SHAPE_COUNT) {
+        // (rows, columns) of the boxes after the anchor; all of them come later in flat order
+        constexpr std::array<std::array<std::pair<int, int>, 2>, SHAPE_COUNT> layouts = {{
+                {{{0, 1}, {0, 0}}}, {{{1, 0}, {0, 0}}}, {{{1, 1}, {0, 0}}}, {{{1, -1}, {0, 0}}},
+                {{{0, 1}, {0, 2}}}, {{{1, 0}, {2, 0}}},
+                {{{0, 1}, {1, 0}}}, {{{0, 1}, {1, 1}}}, {{{1, 0}, {1, 1}}}, {{{1, 0}, {1, -1}}},
+        }};
+        auto stride = static_cast<std::ptrdiff_t>(level.row_stride());
+        for (size_t s = 0; s < SHAPE_COUNT; ++s) {
+            shape_list[s].boxes = s < 4 ? 2 : 3;
+            for (size_t k = 1; k < shape_list[s].boxes; ++k) {
+                auto [rows, columns] = layouts[s][k - 1];
+                shape_list[s].offsets[k] = rows * stride + columns;
+            }
+        }
+    }
+
+    const std::array<Shape, SHAPE_COUNT>& shapes() const {
+        return shape_list;
+    }
+
+    Verdict verdict(size_t anchor, size_t shape) const {
+        return static_cast<Verdict>(verdicts[anchor * SHAPE_COUNT + shape].load(std::memory_order_relaxed));
+    }
+
+    // The first verdict stands, should two searches decide the same placement at once
+    void decide(size_t anchor, size_t shape, Verdict verdict) {
+        uint8_t expected = UNDECIDED;
+        if (verdicts[anchor * SHAPE_COUNT + shape].compare_exchange_strong(expected, verdict) && verdict == DEAD) {
+            dead.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Placements proven dead so far
+    size_t size() const {
+        return dead.load(std::memory_order_relaxed);
+    }
+
+    // Whether the box at `box` is part of a placement already proven dead, e.g. the box that was just pushed there
+    bool touches_dead(const Bitboard& boxes, size_t box) const {
+        return touches_dead(boxes, box, [] (size_t, size_t) -> Verdict {
+            return UNDECIDED;
+        });
+    }
+
+    // Same, but placements holding the box without a verdict yet are decided on the spot: `decide(anchor, shape)`
+    // returns the verdict, or UNDECIDED if it couldn't tell. Only the shapes that could hold the box are probed,
+    // pairs first, and their boxes are only looked at if the placement isn't known to be alive.
+    template <class Decide>
+    bool touches_dead(const Bitboard& boxes, size_t box, Decide&& decide) const {
+        for (size_t s = 0; s < SHAPE_COUNT; ++s) {
+            const Shape& shape = shape_list[s];
+            for (size_t k = 0; k < shape.boxes; ++k) {
+                if (shape.offsets[k] > static_cast<std::ptrdiff_t>(box)) {
+                    continue;
+                }
+                size_t anchor = box - shape.offsets[k];
+                Verdict known = verdict(anchor, s);
+                if (known == ALIVE || !holds(boxes, anchor, shape)) {
+                    continue;
+                }
+                if ((known == UNDECIDED ? decide(anchor, s) : known) == DEAD) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    static bool holds(const Bitboard& boxes, size_t anchor, const Shape& shape) {
+        for (size_t k = 0; k < shape.boxes; ++k) {
+            if (!boxes.test(anchor + shape.offsets[k])) {
+                return false;
+            }
+        }
+        return true;
+    }
+private:
+    std::array<Shape, SHAPE_COUNT> shape_list{};
+    std::vector<std::atomic<uint8_t>> verdicts; // `anchor * SHAPE_COUNT + shape`, a Verdict each
+    std::atomic<size_t> dead = 0;
+};
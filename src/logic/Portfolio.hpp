@@ -0,0 +1,100 @@
+#pragma once
+#include "Solver.hpp"
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <memory>
+#include <optional>
+#include <algorithm>
+
+struct Strategy {
+    SolverMode mode;
+    MoveOrdering ordering = MoveOrdering::BOXES_ON_TARGETS;
+};
+
+// Races several solver configurations on separate threads. The first one to finish decides the outcome
+// (a solution, or a proof there is none) and the rest are cancelled. Every racer gets the whole budget;
+// one running out of it doesn't stop the others. If all of them run out, the result carries the work of the whole race.
+class Portfolio {
+public:
+    Portfolio(const Level& _level, std::vector<Strategy> _strategies = default_strategies())
+            : level(_level), strategies(std::move(_strategies)),
+              deadlock_table(std::make_shared<DeadlockTable>(_level)) {}
+
+    SolveResult solve(const GameState& state, const SearchBudget& budget = {}) {
+        SearchBudget race_budget = budget;
+        race_budget.cancellation = budget.cancellation.child(); // losers are stopped without touching caller's token
+        std::mutex result_mutex;
+        SolveResult result{SolveStatus::BUDGET_EXHAUSTED, {}, {}};
+        SolverStats race_stats;
+        winner = std::nullopt;
+
+        // every strategy gets its own solver: solvers keep per-search state and aren't meant to be shared,
+        // except for the dead placements table: a placement one racer decides is known to the others and later races
+        std::vector<std::unique_ptr<Solver>> solvers;
+        solvers.reserve(strategies.size());
+        for (const Strategy& strategy : strategies) {
+            solvers.push_back(std::make_unique<Solver>(level, strategy.mode, SINGLE_THREAD, strategy.ordering,
+                                                       deadlock_table));
+        }
+
+        auto run = [&] (size_t id) {
+            SolveResult outcome = solvers[id]->solve(state, race_budget);
+            std::lock_guard lock(result_mutex);
+            merge(race_stats, outcome.stats);
+            if (!winner && outcome.status != SolveStatus::BUDGET_EXHAUSTED) {
+                winner = id;
+                result = std::move(outcome);
+                race_budget.cancellation.cancel();
+            }
+        };
+
+        std::vector<std::thread> pool;
+        pool.reserve(strategies.size());
+        for (size_t id = 0; id < strategies.size(); ++id) {
+            pool.emplace_back(run, id);
+        }
+        for (auto& thread : pool) {
+            thread.join();
+        }
+        if (!winner) {
+            result.stats = race_stats;
+        }
+        return result;
+    }
+
+    // Index of the strategy that finished first during the last `solve`
+    std::optional<size_t> winning_strategy() const {
+        return winner;
+    }
+
+    static std::vector<Strategy> default_strategies() {
+        return {
+            Strategy{SolverMode::GREEDY_DFS, MoveOrdering::BOXES_ON_TARGETS},
+            Strategy{SolverMode::GREEDY_DFS, MoveOrdering::LOWER_BOUND},
+            Strategy{SolverMode::GREEDY_DFS, MoveOrdering::GENERATION},
+            Strategy{SolverMode::A_STAR},
+            Strategy{SolverMode::BIDIRECTIONAL},
+        };
+    }
+private:
+    static constexpr size_t SINGLE_THREAD = 1;
+
+    // Racers run side by side: their work and memory add up, while the race takes as long as the slowest of them
+    static void merge(SolverStats& total, const SolverStats& racer) {
+        total.expanded_nodes += racer.expanded_nodes;
+        total.generated_nodes += racer.generated_nodes;
+        total.transposition_cuts += racer.transposition_cuts;
+        total.matching_cuts += racer.matching_cuts;
+        total.pattern_cuts += racer.pattern_cuts;
+        total.learned_patterns = std::max(total.learned_patterns, racer.learned_patterns);
+        total.table_bytes += racer.table_bytes;
+        total.elapsed = std::max(total.elapsed, racer.elapsed);
+    }
+
+    const Level& level;
+    std::vector<Strategy> strategies;
+    std::shared_ptr<DeadlockTable> deadlock_table;
+    std::optional<size_t> winner;
+};
@@ -1,369 +1,1397 @@
 #pragma once
 #include "../game/Level.hpp"
 #include "Paths.hpp"
+#include "Heuristic.hpp"
+#include "Assignment.hpp"
+#include "Patterns.hpp"
+#include "TranspositionTable.hpp"
+#include "Concurrent.hpp"
+#include "Budget.hpp"
+#include "PackedStates.hpp"
 
-#include <unordered_map>
 #include <utility>
+#include <deque>
+#include <queue>
+#include <limits>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <memory>
+#include <algorithm>
+#include <unordered_set>
+#include <mutex>
+
+enum class SolverMode : short {
+    GREEDY_DFS, // depth-first, explores states with more boxes on targets first; fast, but solutions are long
+    A_STAR,     // best-first over pushes with an admissible lower bound; solutions are push-optimal
+    IDA_STAR,   // iterative deepening over the same bound; push-optimal with memory linear in solution depth
+    PARALLEL,   // greedy depth-first order spread over a pool of work-stealing threads
+    HDA_STAR,   // push-optimal A* where every thread owns the states whose hash maps to it
+    BIDIRECTIONAL // breadth-first pushes from the start meet breadth-first pulls from goal configurations
+};
+
+// Order in which depth-first modes (GREEDY_DFS, PARALLEL) try successors of a state
+enum class MoveOrdering : short {
+    BOXES_ON_TARGETS, // states with more boxes on targets first
+    LOWER_BOUND,      // states with the smallest push lower bound first
+    GENERATION        // as generated: untargeted boxes first, no further sorting
+};
+
+struct SolverStats {
+    size_t expanded_nodes = 0;  // states whose successors were generated
+    size_t generated_nodes = 0; // successors put into the frontier
+    size_t transposition_cuts = 0; // states skipped by IDA* because the transposition table had seen them
+    size_t matching_cuts = 0; // states only found dead because their boxes can't all get targets of their own
+    size_t pattern_cuts = 0; // states only found dead because they hold a learned deadlock pattern
+    size_t learned_patterns = 0; // patterns the solver knows by the end of the search, learned by earlier ones included
+    size_t table_bytes = 0; // estimated memory the search held at its end: stored and queued states, nodes, frames
+    std::chrono::microseconds elapsed{0};
+};
+
+enum class SolveStatus : short {
+    SOLVED,
+    UNSOLVABLE,      // the whole reachable state space was searched
+    BUDGET_EXHAUSTED // stopped early by the budget or its cancellation token; nothing is known
+};
+
+struct SolveResult {
+    SolveStatus status;
+    std::vector<Move> moves; // empty unless solved
+    SolverStats stats;
+    bool solved() const {
+        return status == SolveStatus::SOLVED;
+    }
+};
 
 class Solver {
-    using NonIsomorphicStates = std::unordered_map<ReducedState, std::vector<GameState>>;
+    using Solution = std::optional<std::vector<Move>>; // nullopt if not found, no matter why
+    // States are stored packed by their canonical form, so a single lookup tells if an equivalent state was seen
+    using VisitedStates = PackedStates<>;
+    using CostedStates = PackedStates<uint32_t>; // least pushes the state was reached with
 public:
-    Solver(const Level& _level) : level(_level) {}
-    std::vector<Move> solve(const GameState& state) {
-        NonIsomorphicStates states;
-        states.reserve(STATES_CAPACITY);
-        return solve(state, {}, states);
+    // `_threads` is only used by the multi-threaded modes, 0 picks the amount of hardware threads. Solvers of the same
+    // level may share `_deadlock_table`, so that a placement one of them has decided isn't proven again by the others.
+    Solver(const Level& _level,
+           SolverMode _mode = SolverMode::GREEDY_DFS,
+           size_t _threads = 0,
+           MoveOrdering _ordering = MoveOrdering::BOXES_ON_TARGETS,
+           std::shared_ptr<DeadlockTable> _deadlock_table = nullptr)
+            : level(_level), mode(_mode), threads(_threads), ordering(_ordering), heuristic(_level),
+              assignment(_level, heuristic), patterns(_level), small_deadlocks(std::move(_deadlock_table)) {
+        if (threads == 0) {
+            threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+        }
+        if (!small_deadlocks) {
+            small_deadlocks = std::make_shared<DeadlockTable>(level);
+        }
+    }
+
+    SolveResult solve(const GameState& state, const SearchBudget& budget = {}) {
+        auto start = std::chrono::steady_clock::now();
+        statistics = SolverStats{};
+        tracker.reset(budget);
+
+        Solution solution = std::nullopt;
+        if (mode == SolverMode::A_STAR) {
+            solution = solve_a_star(state);
+        } else if (mode == SolverMode::IDA_STAR) {
+            solution = solve_ida_star(state);
+        } else if (mode == SolverMode::PARALLEL) {
+            solution = solve_parallel(state);
+        } else if (mode == SolverMode::HDA_STAR) {
+            solution = solve_hda_star(state);
+        } else if (mode == SolverMode::BIDIRECTIONAL) {
+            solution = solve_bidirectional(state);
+        } else {
+            solution = solve_greedy(state);
+        }
+
+        statistics.table_bytes = tracker.table_size();
+        statistics.learned_patterns = patterns.size();
+        statistics.elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        if (solution) {
+            return SolveResult{SolveStatus::SOLVED, std::move(*solution), statistics};
+        }
+        if (tracker.is_exhausted()) {
+            return SolveResult{SolveStatus::BUDGET_EXHAUSTED, {}, statistics};
+        }
+        return SolveResult{SolveStatus::UNSOLVABLE, {}, statistics};
+    }
+
+    // Dead placements of two or three boxes, as far as the searches so far have met them
+    const DeadlockTable& deadlock_table() const {
+        return *small_deadlocks;
+    }
+
+    // Patterns learned by the searches so far
+    const DeadlockPatterns& deadlock_patterns() const {
+        return patterns;
     }
 private:
     static constexpr size_t STATES_CAPACITY = 10000;
-    static constexpr size_t SUBSTATES_CAPACITY = 100;
+    static constexpr size_t TRANSPOSITION_TABLE_BYTES = 4 * 1024 * 1024;
+    static constexpr size_t GOAL_CONFIGURATIONS_LIMIT = 256;
+    static constexpr size_t PATTERN_BOXES = 8;   // dead ends with more boxes around the player aren't learned from
+    static constexpr size_t PATTERN_NODES = 256; // per player area, for the search proving a pattern dead
+    static constexpr size_t UNBOUNDED = std::numeric_limits<size_t>::max();
     const Level& level;
+    SolverMode mode;
+    size_t threads;
+    MoveOrdering ordering;
+    Heuristic heuristic;
+    TargetAssignment assignment;
+    DeadlockPatterns patterns; // kept between searches, they only depend on the level
+    std::unordered_set<Bitboard> unproven; // suspects `learn` failed to prove dead
+    std::mutex unproven_mutex;
+    std::shared_ptr<DeadlockTable> small_deadlocks; // decided as the searches go, kept between them like patterns
+    SolverStats statistics;
+    BudgetTracker tracker;
 
-    struct NextState {
+    // Only the push leading from the parent state is kept; the walk before it is plotted when a solution is emitted
+    struct SearchNode {
+        const SearchNode* parent;
+        Point box;
+        Move push; // NONE for the start
+        uint32_t length; // cells the box went, more than one for macro pushes
+        SearchNode(const SearchNode* _parent, Point _box, Move _push, size_t _length = 1)
+                : parent(_parent), box(_box), push(_push), length(static_cast<uint32_t>(_length)) {}
+    };
+
+    struct Frontier {
         GameState state;
-        std::vector<Move> moves;
-        NextState(const NextState& other) = default;
-        NextState(const GameState&  _state, std::vector<Move>  _moves) : state(_state), moves(std::move(_moves)) {}
-        NextState& operator=(const NextState& other) {
-            state = GameState(other.state);
-            moves = other.moves;
-            return *this;
+        const SearchNode* node;
+        Frontier(const GameState& _state, const SearchNode* _node) : state(_state), node(_node) {}
+    };
+
+    struct OpenEntry {
+        GameState state;
+        const SearchNode* node;
+        size_t pushes;
+        size_t estimate;
+        OpenEntry(const GameState& _state, const SearchNode* _node, size_t _pushes, size_t _estimate)
+                : state(_state), node(_node), pushes(_pushes), estimate(_estimate) {}
+        bool operator<(const OpenEntry& other) const {
+            // inverse check due to c++ heap-queue behaviour; among equal totals deeper states go first
+            size_t total = pushes + estimate;
+            size_t other_total = other.pushes + other.estimate;
+            if (total == other_total) {
+                return pushes < other.pushes;
+            }
+            return total > other_total;
         }
-        bool operator<(const NextState& other) const {
-            return state.count_boxes_on_target() > other.state.count_boxes_on_target();
+    };
+
+    // Successor described by the push alone, applied to a state in place with `GameState::make_push`. Macro pushes
+    // take the box several cells at once (through a tunnel or into a goal room) and cost a push per cell.
+    struct Push {
+        Point box;
+        Move move;
+        size_t length = 1;
+        size_t score = 0; // ordering key: boxes on targets or lower bound, depending on the mode
+        Point push_position() const {
+            return box.move(opposite(move));
         }
     };
 
-    std::vector<Move> solve(const GameState& state,
-                            const std::vector<Move>& initial_moves,
-                            NonIsomorphicStates& states) {
+    struct NextState {
+        GameState state;
+        Push push;
+        NextState(const GameState& _state, const Push& _push) : state(_state), push(_push) {}
+    };
+
+    struct Worker {
+        WorkStealingDeque<Frontier> work;
+        std::deque<SearchNode> nodes; // owned by the worker; others only follow pointers to already published nodes
+        SolverStats stats;
+    };
+
+    struct PullNode {
+        const PullNode* parent;
+        Point player; // where the player stands before pushing the crate back towards the parent configuration
+        Move push;
+    };
+
+    struct PullFrontier {
+        GameState state;
+        const PullNode* node;
+        PullFrontier(const GameState& _state, const PullNode* _node) : state(_state), node(_node) {}
+    };
+
+    // States of both searches share one table, so every insertion also checks whether the other side was there
+    struct MeetingEntry {
+        const SearchNode* forward;
+        const PullNode* backward;
+    };
+    using MeetingStates = PackedStates<MeetingEntry>;
+
+    struct HashWorker {
+        explicit HashWorker(const Level& level) : closed(level) {}
+        MpscQueue<OpenEntry> inbox;
+        std::priority_queue<OpenEntry> open; // private, as well as everything below
+        CostedStates closed;
+        std::deque<SearchNode> nodes;
+        SolverStats stats;
+    };
+
+    // One state on the path of a depth-first search. The state itself isn't stored: the search keeps a single
+    // GameState, makes the push when entering a frame and unmakes it when leaving.
+    struct DepthFrame {
+        std::optional<Push> entered; // push leading from the previous frame, none for the root
+        GameState::PushUndo undo;
+        size_t pushes;
+        std::vector<Push> children;
+        size_t next_child = 0;
+        DepthFrame() : undo{}, pushes(0) {}
+        DepthFrame(const Push& _entered, const GameState::PushUndo& _undo, size_t _pushes = 0)
+                : entered(_entered), undo(_undo), pushes(_pushes) {}
+    };
+
+    Solution solve_greedy(const GameState& initial) {
+        // Depth-first over the path of frames. Children are visited in order, so every state is checked against
+        // the visited set when the search steps into it, exactly as if all of them were put on a stack at once.
+        VisitedStates states(level);
+        states.reserve(STATES_CAPACITY);
+        GameState state = initial;
+        std::vector<DepthFrame> path;
+
         if (state.is_victory()) {
-            return initial_moves;
+            return std::vector<Move>{};
+        }
+        if (!enter_greedy(state, states, path, DepthFrame())) {
+            return std::nullopt;
+        }
+        while (!path.empty() && !tracker.is_exhausted()) {
+            DepthFrame& frame = path.back();
+            if (frame.next_child == frame.children.size()) {
+                leave(state, path);
+                continue;
+            }
+            Push push = frame.children[frame.next_child++]; // `frame` is invalid once a child is entered
+            GameState::PushUndo undo = state.make_push(push.box, push.move, push.length);
+            if (state.is_victory()) {
+                return path_solution(initial, path, push);
+            }
+            if (!enter_greedy(state, states, path, DepthFrame(push, undo))) {
+                state.unmake_push(undo);
+            }
         }
-        if (!validate_state_uniqueness(state, states)) {
-            return {};
+        return std::nullopt;
+    }
+
+    // Visits the current state; returns false if it was seen before, or is a dead end the search can't step into
+    bool enter_greedy(GameState& state, VisitedStates& states, std::vector<DepthFrame>& path, DepthFrame frame) {
+        Bitboard reachable = state.reachable(); // one flood fill serves the visited set and the push generation
+        if (!states.insert(state, state.canonical_player_pos(reachable))) {
+            return false;
         }
+        tracker.charge_table(states.bytes_per_state());
 
         // fail fast heuristics
-        if (is_unsolvable(state)) {
-            return {};
+        if (is_unsolvable(state, statistics) || !tracker.charge_expansion()) {
+            return false;
         }
+        ++statistics.expanded_nodes;
 
-        // we don't really care about empty cells non-adjacent to crates,
-        // assuming we can walk straight through them with A*.
-        auto pushable_boxes = state.all_pushable_boxes();
-        if (pushable_boxes.empty()) {
-            return {}; // no solution
+        frame.children = pushes(state, reachable);
+        order(state, frame.children);
+        statistics.generated_nodes += frame.children.size();
+        tracker.charge_table(frame_bytes(frame));
+        path.push_back(std::move(frame));
+        return true;
+    }
+
+    void leave(GameState& state, std::vector<DepthFrame>& path) {
+        if (path.back().entered) {
+            state.unmake_push(path.back().undo);
         }
+        tracker.release_table(frame_bytes(path.back()));
+        path.pop_back();
+    }
 
-        std::vector<Path> reachable_push_positions;
-        std::vector<Move> push_commands;
-        reachable_push_positions.reserve(pushable_boxes.size());
-        push_commands.reserve(pushable_boxes.size());
+    static size_t frame_bytes(const DepthFrame& frame) {
+        return sizeof(DepthFrame) + frame.children.capacity() * sizeof(Push);
+    }
 
-        // For each crate analyze from which side it can be pushed. Pushing is possible if two conditions are satisfied:
-        // 1. push-position provided by game state with respect to walls and other crates
-        // 2. position before the crate is reachable by player (or player already stands there)
-        prioritise_untargeted_boxes(pushable_boxes);
-        for (const PushableBox& pushable_box : pushable_boxes) {
-            const auto& allowed_moves = pushable_box.allowed_moves; // (1) valid push positions from game state
-
-            for (Move move : allowed_moves) {
-                Point player_pos_before_box{};
-                // if we need to press 'W' to move the box, it means push position is right below it. Hence `.move(S)`.
-                if (move == Move::W) {
-                    player_pos_before_box = pushable_box.crate_pos.move(Move::S);
-                } else if (move == Move::S) { // ...and so on.
-                    player_pos_before_box = pushable_box.crate_pos.move(Move::W);
-                } else if (move == Move::A) {
-                    player_pos_before_box = pushable_box.crate_pos.move(Move::D);
-                } else {
-                    player_pos_before_box = pushable_box.crate_pos.move(Move::A);
+    // Memory of an entry queued with its state, whatever the state's board allocated included
+    template <class Entry>
+    static size_t queued_bytes(const GameState& state) {
+        return sizeof(Entry) + state.allocated_bytes();
+    }
+
+    std::vector<Move> path_solution(const GameState& initial, const std::vector<DepthFrame>& path, const Push& last) const {
+        std::vector<Push> chain;
+        chain.reserve(path.size());
+        for (const DepthFrame& frame : path) {
+            if (frame.entered) {
+                chain.push_back(*frame.entered);
+            }
+        }
+        chain.push_back(last);
+        return walk_pushes(initial, chain);
+    }
+
+    // Spells out the pushes as moves, plotting the walk before each of them. Runs once per solution, so generating
+    // a search node never costs more than the push itself.
+    std::vector<Move> walk_pushes(const GameState& initial, const std::vector<Push>& chain) const {
+        std::vector<Move> moves;
+        GameState replay = initial;
+        for (const Push& push : chain) {
+            // the search only makes pushes whose position the player can reach, so there always is a walk
+            std::optional<Path> walk = Paths::plot_path(level, replay.player_pos(), push.push_position(),
+                                                        replay.walkable());
+            std::vector<Move> steps = Paths::as_moves(*walk);
+            moves.insert(moves.end(), steps.begin(), steps.end());
+            moves.insert(moves.end(), push.length, push.move);
+            replay.make_push(push.box, push.move, push.length);
+        }
+        return moves;
+    }
+
+    Solution solve_a_star(const GameState& state) {
+        // With a consistent lower bound the first time a state leaves the open list it has the minimal push count,
+        // so the closed set can be the same plain set of visited states the greedy search uses.
+        VisitedStates closed(level);
+        closed.reserve(STATES_CAPACITY);
+
+        std::deque<SearchNode> nodes;
+        std::priority_queue<OpenEntry> open;
+
+        size_t estimate = heuristic.lower_bound(state);
+        if (estimate == Heuristic::DEADLOCK) {
+            return std::nullopt;
+        }
+        nodes.emplace_back(nullptr, Point{}, Move::NONE);
+        open.emplace(state, &nodes.back(), 0, estimate);
+        tracker.charge_table(sizeof(SearchNode) + queued_bytes<OpenEntry>(state));
+
+        while (!open.empty() && !tracker.is_exhausted()) {
+            OpenEntry current = open.top();
+            open.pop();
+            tracker.release_table(queued_bytes<OpenEntry>(current.state));
+
+            if (current.state.is_victory()) {
+                return rebuild_solution(state, current.node);
+            }
+            Bitboard reachable = current.state.reachable();
+            if (!closed.insert(current.state, current.state.canonical_player_pos(reachable))) {
+                continue;
+            }
+            tracker.charge_table(closed.bytes_per_state());
+            if (is_unsolvable(current.state, statistics)) {
+                continue;
+            }
+            if (!tracker.charge_expansion()) {
+                break;
+            }
+            ++statistics.expanded_nodes;
+
+            for (auto& next : successors(current.state, reachable)) {
+                size_t next_estimate = heuristic.lower_bound(next.state);
+                if (next_estimate == Heuristic::DEADLOCK) {
+                    continue;
                 }
+                nodes.emplace_back(current.node, next.push.box, next.push.move, next.push.length);
+                open.emplace(next.state, &nodes.back(), current.pushes + next.push.length, next_estimate);
+                tracker.charge_table(sizeof(SearchNode) + queued_bytes<OpenEntry>(next.state));
+                ++statistics.generated_nodes;
+            }
+        }
+        return std::nullopt;
+    }
+
+    Solution solve_ida_star(const GameState& state) {
+        // Only the current path lives in memory: each frame keeps its state and not yet visited children.
+        // Repetitions are cut by a fixed-size table instead of a closed set, so memory doesn't grow with the search.
+        if (state.is_victory()) {
+            return std::vector<Move>{};
+        }
+        size_t threshold = heuristic.lower_bound(state);
+        if (threshold == Heuristic::DEADLOCK) {
+            return std::nullopt;
+        }
+
+        // the table takes at most half of the memory budget, the path frames need the rest
+        TranspositionTable table(std::min(TRANSPOSITION_TABLE_BYTES, tracker.max_table_bytes() / 2));
+        tracker.charge_table(table.size_in_bytes());
+        GameState current = state;
+        std::vector<DepthFrame> path;
+        uint32_t iteration = 0;
+
+        while (threshold != UNBOUNDED && !tracker.is_exhausted()) {
+            ++iteration;
+            size_t next_threshold = UNBOUNDED;
 
-                // (2) check if push position near the crate is reachable
-                std::optional<Path> o_path = std::nullopt;
-                if (player_pos_before_box == state.player_pos()) { // player already near the crate, ready to push
-                    o_path = Path(player_pos_before_box, player_pos_before_box);
-                } else { // A*
-                    o_path = Paths::plot_path(state.player_pos(), player_pos_before_box, state.f_adjacent_walkable());
+            path.clear(); // the previous iteration has unwound `current` back to the start
+            path.emplace_back();
+            Bitboard reachable = current.reachable();
+            table.visited(current.canonical_hash(current.canonical_player_pos(reachable)), 0, iteration);
+            expand_within(current, reachable, path.back(), threshold, next_threshold);
+
+            while (!path.empty() && !tracker.is_exhausted()) {
+                DepthFrame& frame = path.back();
+                if (frame.next_child == frame.children.size()) {
+                    leave(current, path);
+                    continue;
                 }
+                Push push = frame.children[frame.next_child++]; // `frame` is invalid once a child is entered
+                size_t pushes = frame.pushes + push.length;
+                GameState::PushUndo undo = current.make_push(push.box, push.move, push.length);
 
-                if (o_path) {
-                    reachable_push_positions.push_back(*o_path);
-                    push_commands.push_back(move);
+                if (current.is_victory()) {
+                    return path_solution(state, path, push);
+                }
+                reachable = current.reachable();
+                uint64_t hash = current.canonical_hash(current.canonical_player_pos(reachable));
+                if (table.visited(hash, static_cast<uint32_t>(pushes), iteration)) {
+                    ++statistics.transposition_cuts;
+                    current.unmake_push(undo);
+                    continue;
+                }
+                if (is_unsolvable(current, statistics)) {
+                    current.unmake_push(undo);
+                    continue;
                 }
+
+                path.emplace_back(push, undo, pushes);
+                expand_within(current, reachable, path.back(), threshold, next_threshold);
             }
+            threshold = next_threshold;
         }
+        return std::nullopt;
+    }
 
-        // combine found paths with push commands to create new states
-        auto i_path = reachable_push_positions.begin();
-        auto i_command = push_commands.begin();
-        std::vector<NextState> next_states;
-        next_states.reserve(reachable_push_positions.size());
+    Solution solve_parallel(const GameState& state) {
+        // Every state is pushed to a deque before it's counted as pending and counted off only after its successors
+        // were pushed, so `pending` drops to zero exactly when there is no work left anywhere.
+        ShardedTable<VisitedStates> visited(level);
+        std::vector<Worker> workers(threads);
+        std::atomic<size_t> pending = 1;
+        std::atomic<bool> done = false;
+        std::mutex solution_mutex;
+        const SearchNode* solution = nullptr;
 
-        for (; i_path != reachable_push_positions.end() && i_command != push_commands.end(); ++i_path, ++i_command) {
-            auto walk_commands = Paths::as_moves(*i_path);
-            auto push_command = *i_command;
+        workers[0].nodes.emplace_back(nullptr, Point{}, Move::NONE);
+        workers[0].work.push(Frontier(state, &workers[0].nodes.back()));
+        tracker.charge_table(sizeof(SearchNode) + queued_bytes<Frontier>(state));
 
-            GameState next_state = state;
-            next_state.issue_orders(walk_commands);
-            next_state.issue_order(push_command);
+        auto run = [&] (size_t id) {
+            Worker& worker = workers[id];
+            while (!done.load(std::memory_order_relaxed) && !tracker.is_exhausted()) {
+                std::optional<Frontier> o_current = worker.work.pop();
+                for (size_t i = 1; !o_current && i < workers.size(); ++i) {
+                    o_current = workers[(id + i) % workers.size()].work.steal();
+                }
+                if (!o_current) {
+                    if (pending.load() == 0) {
+                        return;
+                    }
+                    std::this_thread::yield();
+                    continue;
+                }
+
+                const Frontier& current = *o_current;
+                tracker.release_table(queued_bytes<Frontier>(current.state));
+                if (current.state.is_victory()) {
+                    std::lock_guard lock(solution_mutex);
+                    if (!solution) {
+                        solution = current.node;
+                    }
+                    done = true;
+                    return;
+                }
+
+                Bitboard reachable = current.state.reachable();
+                Point canonical = current.state.canonical_player_pos(reachable);
+                size_t stored_bytes = 0;
+                bool unique = visited.with_shard(current.state.canonical_hash(canonical), [&] (VisitedStates& states) {
+                    stored_bytes = states.bytes_per_state();
+                    return states.insert(current.state, canonical);
+                });
+                if (unique) {
+                    tracker.charge_table(stored_bytes);
+                }
+                if (unique && !is_unsolvable(current.state, worker.stats) && tracker.charge_expansion()) {
+                    ++worker.stats.expanded_nodes;
+                    GameState state = current.state;
+                    std::vector<Push> candidates = pushes(state, reachable);
+                    order(state, candidates);
+                    worker.stats.generated_nodes += candidates.size();
 
-            std::vector<Move> moves = initial_moves;
-            moves.insert(moves.end(), walk_commands.begin(), walk_commands.end());
-            moves.push_back(push_command);
+                    // the deque is a stack for its owner, so the most promising state has to be pushed last
+                    pending += candidates.size();
+                    for (auto it = candidates.rbegin(); it != candidates.rend(); ++it) {
+                        worker.nodes.emplace_back(current.node, it->box, it->move, it->length);
+                        GameState next = current.state;
+                        next.make_push(it->box, it->move, it->length);
+                        tracker.charge_table(sizeof(SearchNode) + queued_bytes<Frontier>(next));
+                        worker.work.push(Frontier(next, &worker.nodes.back()));
+                    }
+                }
+                --pending;
+            }
+        };
 
-            next_states.emplace_back(next_state, moves);
+        std::vector<std::thread> pool;
+        pool.reserve(threads - 1);
+        for (size_t id = 1; id < threads; ++id) {
+            pool.emplace_back(run, id);
+        }
+        run(0);
+        for (auto& thread : pool) {
+            thread.join();
         }
 
-        // heuristic priority for states that have more boxes on targets
-        std::sort(next_states.begin(), next_states.end());
-        for (const auto& next : next_states) {
-            auto result = solve(next.state, next.moves, states); // solve each (N+1)th state recursively
-            if (!result.empty()) {
-                return result;
-            }
+        for (const Worker& worker : workers) {
+            statistics.expanded_nodes += worker.stats.expanded_nodes;
+            statistics.generated_nodes += worker.stats.generated_nodes;
+            statistics.matching_cuts += worker.stats.matching_cuts;
+            statistics.pattern_cuts += worker.stats.pattern_cuts;
+        }
+        if (!solution) {
+            return std::nullopt;
         }
-        return {};
+        return rebuild_solution(state, solution);
     }
 
-    void prioritise_untargeted_boxes(std::vector<PushableBox>& boxes) {
-        std::sort(boxes.begin(), boxes.end(), [&] (const auto& a, const auto &b) -> bool {
-            bool a_ok = level.at(a.crate_pos)->type == CellType::TARGET;
-            bool b_ok = level.at(b.crate_pos)->type == CellType::TARGET;
-            if (a_ok == b_ok || !a_ok) {
-                return true;
+    Solution solve_hda_star(const GameState& state) {
+        // Each state belongs to the thread picked by the hash of its canonical form, so equivalent states always
+        // meet at the same owner. Owners never share their open and closed lists, successors are
+        // mailed to their owners instead. Threads don't expand in global f-order, so a state may be reopened
+        // when reached cheaper, and the first solution isn't final: the search goes on until nothing cheaper remains.
+        //
+        // `pending` counts states sent but not yet processed, incremented before sending and decremented after
+        // the successors were sent. It reaches zero only when every inbox and open list is empty.
+        size_t estimate = heuristic.lower_bound(state);
+        if (estimate == Heuristic::DEADLOCK) {
+            return std::nullopt;
+        }
+
+        std::deque<HashWorker> workers; // neither copyable nor movable, but a deque grows in place
+        for (size_t id = 0; id < threads; ++id) {
+            workers.emplace_back(level);
+        }
+        std::atomic<size_t> pending = 1;
+        std::atomic<size_t> best_pushes = UNBOUNDED;
+        std::mutex solution_mutex;
+        const SearchNode* solution = nullptr;
+
+        auto owner = [&] (const GameState& s) -> HashWorker& {
+            return workers[s.canonical_hash() % workers.size()];
+        };
+        workers[0].nodes.emplace_back(nullptr, Point{}, Move::NONE);
+        owner(state).inbox.push(OpenEntry(state, &workers[0].nodes.back(), 0, estimate));
+        tracker.charge_table(sizeof(SearchNode) + queued_bytes<OpenEntry>(state));
+
+        auto run = [&] (size_t id) {
+            HashWorker& worker = workers[id];
+            while (!tracker.is_exhausted()) {
+                worker.inbox.drain([&] (OpenEntry&& entry) {
+                    worker.open.push(std::move(entry));
+                });
+                if (worker.open.empty()) {
+                    if (pending.load() == 0) {
+                        return;
+                    }
+                    std::this_thread::yield();
+                    continue;
+                }
+
+                OpenEntry current = worker.open.top();
+                worker.open.pop();
+                tracker.release_table(queued_bytes<OpenEntry>(current.state));
+
+                if (current.pushes + current.estimate >= best_pushes.load()) {
+                    // can't beat the incumbent solution
+                } else if (current.state.is_victory()) {
+                    std::lock_guard lock(solution_mutex);
+                    if (current.pushes < best_pushes.load()) {
+                        best_pushes = current.pushes;
+                        solution = current.node;
+                    }
+                } else if (Bitboard reachable = current.state.reachable();
+                           improve_closed(current.state, current.state.canonical_player_pos(reachable), current.pushes,
+                                          worker.closed)
+                           && !is_unsolvable(current.state, worker.stats) && tracker.charge_expansion()) {
+                    ++worker.stats.expanded_nodes;
+                    for (auto& next : successors(current.state, reachable)) {
+                        size_t next_estimate = heuristic.lower_bound(next.state);
+                        size_t pushes = current.pushes + next.push.length;
+                        if (next_estimate == Heuristic::DEADLOCK || pushes + next_estimate >= best_pushes.load()) {
+                            continue;
+                        }
+                        worker.nodes.emplace_back(current.node, next.push.box, next.push.move, next.push.length);
+                        OpenEntry entry(next.state, &worker.nodes.back(), pushes, next_estimate);
+                        tracker.charge_table(sizeof(SearchNode) + queued_bytes<OpenEntry>(entry.state));
+                        ++pending;
+                        ++worker.stats.generated_nodes;
+                        HashWorker& next_owner = owner(entry.state);
+                        if (&next_owner == &worker) {
+                            worker.open.push(std::move(entry));
+                        } else {
+                            next_owner.inbox.push(std::move(entry));
+                        }
+                    }
+                }
+                --pending;
             }
-            return false;
-        });
+        };
+
+        std::vector<std::thread> pool;
+        pool.reserve(threads - 1);
+        for (size_t id = 1; id < threads; ++id) {
+            pool.emplace_back(run, id);
+        }
+        run(0);
+        for (auto& thread : pool) {
+            thread.join();
+        }
+
+        for (const HashWorker& worker : workers) {
+            statistics.expanded_nodes += worker.stats.expanded_nodes;
+            statistics.generated_nodes += worker.stats.generated_nodes;
+            statistics.matching_cuts += worker.stats.matching_cuts;
+            statistics.pattern_cuts += worker.stats.pattern_cuts;
+        }
+        if (tracker.is_exhausted()) {
+            return std::nullopt; // the incumbent solution may be not optimal yet
+        }
+        if (!solution) {
+            return std::nullopt;
+        }
+        return rebuild_solution(state, solution);
     }
 
-    bool is_unsolvable(const GameState& state) const {
-        for (Point box : state.box_positions()) {
-            if (auto o_cell = level.at(box); !o_cell || o_cell->type != CellType::TARGET) {
-                if (is_unmovable_quad(box, state.box_positions())) {
-                    return true;
+    Solution solve_bidirectional(const GameState& state) {
+        // Forward search pushes crates from the start, backward search pulls them from every configuration with all
+        // crates on targets. Each round expands a whole layer of the smaller frontier. Any state found by both sides
+        // connects the start with a victory, and if either side runs out of states there is no solution at all.
+        if (state.is_victory()) {
+            return std::vector<Move>{};
+        }
+        MeetingStates meetings(level);
+        meetings.reserve(STATES_CAPACITY);
+        std::deque<SearchNode> forward_nodes;
+        std::deque<PullNode> backward_nodes;
+        std::vector<Frontier> forward;
+        std::vector<PullFrontier> backward;
+        std::vector<Frontier> next_forward;
+        std::vector<PullFrontier> next_backward;
+
+        forward_nodes.emplace_back(nullptr, Point{}, Move::NONE);
+        forward.emplace_back(state, &forward_nodes.back());
+        tracker.charge_table(sizeof(SearchNode) + queued_bytes<Frontier>(state));
+        meet(forward.back().state, forward.back().node, nullptr, meetings);
+
+        bool backward_complete = true;
+        for (const GameState& goal : goal_configurations(state, backward_complete)) {
+            backward_nodes.push_back(PullNode{nullptr, goal.player_pos(), Move::NONE});
+            tracker.charge_table(sizeof(PullNode));
+            if (const MeetingEntry* met = meet(goal, nullptr, &backward_nodes.back(), meetings); met) {
+                return join_solution(state, met->forward, &backward_nodes.back());
+            }
+            backward.emplace_back(goal, &backward_nodes.back());
+            tracker.charge_table(queued_bytes<PullFrontier>(goal));
+        }
+
+        while (!forward.empty() && !tracker.is_exhausted()) {
+            if (backward.empty() && backward_complete) {
+                return std::nullopt; // every configuration leading to a victory was met, none of them is reachable
+            }
+
+            if (!backward.empty() && backward.size() < forward.size()) {
+                for (const PullFrontier& current : backward) {
+                    if (!tracker.charge_expansion()) {
+                        return std::nullopt;
+                    }
+                    ++statistics.expanded_nodes;
+                    for (auto& [previous, player, push] : predecessors(current.state)) {
+                        backward_nodes.push_back(PullNode{current.node, player, push});
+                        tracker.charge_table(sizeof(PullNode));
+                        const MeetingEntry* met = meet(previous, nullptr, &backward_nodes.back(), meetings);
+                        if (met && met->forward) {
+                            return join_solution(state, met->forward, &backward_nodes.back());
+                        }
+                        if (!met) {
+                            ++statistics.generated_nodes;
+                            next_backward.emplace_back(previous, &backward_nodes.back());
+                            tracker.charge_table(queued_bytes<PullFrontier>(previous));
+                        }
+                    }
                 }
-                if (is_locked_to_wall(box)) {
-                    return true;
+                release_layer(backward);
+                backward.swap(next_backward);
+                next_backward.clear();
+            } else {
+                for (const Frontier& current : forward) {
+                    if (is_unsolvable(current.state, statistics)) {
+                        continue;
+                    }
+                    if (!tracker.charge_expansion()) {
+                        return std::nullopt;
+                    }
+                    ++statistics.expanded_nodes;
+                    for (auto& next : successors(current.state, current.state.reachable())) {
+                        forward_nodes.emplace_back(current.node, next.push.box, next.push.move, next.push.length);
+                        tracker.charge_table(sizeof(SearchNode));
+                        if (next.state.is_victory()) {
+                            return rebuild_solution(state, &forward_nodes.back());
+                        }
+                        const MeetingEntry* met = meet(next.state, &forward_nodes.back(), nullptr, meetings);
+                        if (met && met->backward) {
+                            return join_solution(state, &forward_nodes.back(), met->backward);
+                        }
+                        if (!met) {
+                            ++statistics.generated_nodes;
+                            next_forward.emplace_back(next.state, &forward_nodes.back());
+                            tracker.charge_table(queued_bytes<Frontier>(next.state));
+                        }
+                    }
                 }
+                release_layer(forward);
+                forward.swap(next_forward);
+                next_forward.clear();
             }
         }
-        return false;
+        return std::nullopt;
     }
 
-    bool is_unmovable_quad(Point box, const std::unordered_set<Point>& boxes) const {
-        Point r = box.move(Move::D);
-        Point d = box.move(Move::S);
-        Point rd = box.move(Move::S).move(Move::D);
-        bool is_quad = boxes.contains(r) && boxes.contains(d) && boxes.contains(rd);
-        if (is_quad) {
-            for (Point p : {box, r, d, rd}) {
-                if (level.at(p)->type != CellType::TARGET) {
-                    return true; // boxes form a 2x2 quad and at least one is not on target cell - that's a deadlock
+    // Gives back the memory of a frontier layer once it has been expanded
+    template <class Entry>
+    void release_layer(const std::vector<Entry>& layer) {
+        for (const Entry& entry : layer) {
+            tracker.release_table(queued_bytes<Entry>(entry.state));
+        }
+    }
+
+    // Registers the state for the given side. Returns nullptr if it's new, otherwise the entry found (valid until
+    // the next registration): either the same side was there already, or the other side was and the searches have met.
+    const MeetingEntry* meet(const GameState& state,
+                             const SearchNode* forward,
+                             const PullNode* backward,
+                             MeetingStates& meetings) {
+        auto [entry, inserted] = meetings.try_emplace(state, MeetingEntry{forward, backward});
+        if (inserted) {
+            tracker.charge_table(meetings.bytes_per_state());
+            return nullptr;
+        }
+        return &entry;
+    }
+
+    std::vector<Move> join_solution(const GameState& state, const SearchNode* forward, const PullNode* backward) const {
+        // pulls turn into pushes in reverse order, after the pushes of the forward side
+        std::vector<Push> chain = push_chain(forward);
+        for (const PullNode* node = backward; node->parent; node = node->parent) {
+            chain.push_back(Push{node->player.move(node->push), node->push});
+        }
+        return walk_pushes(state, chain);
+    }
+
+    struct PreviousState {
+        GameState state;
+        Point player;
+        Move push;
+    };
+
+    std::vector<PreviousState> predecessors(const GameState& state) const {
+        // For each crate and side: the player has to reach the cell next to the crate and step further away from it.
+        // In the resulting state the player pushes the crate back, so the push goes towards the crate's old cell.
+        std::vector<PreviousState> result;
+        std::vector<Point> boxes = state.box_positions();
+        Bitboard reachable = state.reachable();
+        for (Point box : boxes) {
+            for (Move push : {Move::W, Move::A, Move::S, Move::D}) {
+                Point pull_position = box.move(opposite(push));
+                Point step = pull_position.move(opposite(push));
+                if (!reachable.test(level.index(pull_position)) || !is_free(step, state)) {
+                    continue;
                 }
-                return false;
+                GameState previous(level, pull_position, boxes);
+                previous.issue_pull(opposite(push));
+                result.push_back(PreviousState{previous, step, push});
             }
         }
-        return false;
+        return result;
     }
 
-    bool is_locked_to_wall(Point box) const {
-        // Trying to detect stick-to-the-wall deadlocks. For example, the crate here is wasted:
-        // #    x           #
-        // ##################
-        //
-        // Note: if there is target point along the wall, we consider it winnable and do not fail. E.g.
-        // #    x        .  #  <--- crate can be pushed to target, even though it's stuck with this path along the wall
-        // ##################
-        Point w = box.move(Move::W);
-        Point a = box.move(Move::A);
-        Point s = box.move(Move::S);
-        Point d = box.move(Move::D);
-
-        bool w_wall = level.at(w)->type == CellType::WALL;
-        bool a_wall = level.at(a)->type == CellType::WALL;
-        bool s_wall = level.at(s)->type == CellType::WALL;
-        bool d_wall = level.at(d)->type == CellType::WALL;
-
-        if (!w_wall && !a_wall && !s_wall && !d_wall) {
-            return false;
+    std::vector<GameState> goal_configurations(const GameState& state, bool& complete) const {
+        // Crates on every combination of targets (just one, unless there are spare targets), with the player
+        // in every separate area the crates leave. Too many combinations are cut, and the backward search
+        // then can't prove unsolvability.
+        const auto& targets = heuristic.target_positions();
+        size_t box_count = state.box_board().count();
+        std::vector<GameState> result;
+        if (box_count > targets.size()) {
+            return result;
         }
 
-        if (w_wall && is_locked_to_wall(box, w)) {
-            return true;
+        std::vector<bool> chosen(targets.size(), false);
+        std::fill(chosen.begin(), chosen.begin() + static_cast<std::ptrdiff_t>(box_count), true);
+        size_t combinations = 0;
+        do {
+            if (++combinations > GOAL_CONFIGURATIONS_LIMIT) {
+                complete = false;
+                break;
+            }
+            std::vector<Point> boxes;
+            for (size_t i = 0; i < targets.size(); ++i) {
+                if (chosen[i]) {
+                    boxes.push_back(targets[i]);
+                }
+            }
+            GameState goal(level, state.player_pos(), boxes);
+            for (Point player : area_representatives(goal)) {
+                result.emplace_back(level, player, boxes);
+            }
+        } while (std::prev_permutation(chosen.begin(), chosen.end()));
+        return result;
+    }
+
+    std::vector<Point> area_representatives(const GameState& state) const {
+        // one cell of each connected area of walkable cells
+        std::vector<bool> seen(level.cell_count(), false);
+        std::vector<Point> result;
+        std::vector<size_t> stack;
+        for (size_t start = 0; start < level.cell_count(); ++start) {
+            if (seen[start] || !is_free(start, state)) {
+                continue;
+            }
+            result.push_back(level.point(start));
+            seen[start] = true;
+            stack.push_back(start);
+            while (!stack.empty()) {
+                size_t current = stack.back();
+                stack.pop_back();
+                for (Move move : Level::MOVES) {
+                    size_t next = level.neighbour(current, move);
+                    if (!seen[next] && is_free(next, state)) {
+                        seen[next] = true;
+                        stack.push_back(next);
+                    }
+                }
+            }
         }
-        if (a_wall && is_locked_to_wall(box, a)) {
-            return true;
+        return result;
+    }
+
+    bool is_free(size_t index, const GameState& state) const {
+        return !level.is_wall(index) && !state.has_box(index);
+    }
+
+    bool is_free(Point p, const GameState& state) const {
+        return is_free(level.index(p), state);
+    }
+
+    void order(GameState& state, std::vector<Push>& candidates) const {
+        // the most promising push goes first; the state is stepped into every candidate and back to score it
+        if (ordering == MoveOrdering::GENERATION) {
+            return;
         }
-        if (s_wall && is_locked_to_wall(box, s)) {
-            return true;
+        for (Push& push : candidates) {
+            GameState::PushUndo undo = state.make_push(push.box, push.move, push.length);
+            if (ordering == MoveOrdering::BOXES_ON_TARGETS) {
+                push.score = state.count_boxes_on_target();
+            } else {
+                push.score = heuristic.lower_bound(state);
+            }
+            state.unmake_push(undo);
         }
-        if (d_wall && is_locked_to_wall(box, d)) {
-            return true;
+        if (ordering == MoveOrdering::BOXES_ON_TARGETS) {
+            std::stable_sort(candidates.begin(), candidates.end(), [] (const auto& a, const auto& b) -> bool {
+                return a.score > b.score;
+            });
+        } else {
+            std::stable_sort(candidates.begin(), candidates.end(), [] (const auto& a, const auto& b) -> bool {
+                return a.score < b.score;
+            });
         }
-        return false;
     }
 
-    bool is_locked_to_wall(Point box, Point wall) const {
-        bool is_horizontal_lock = wall.y == box.y; // remember, `x` is actually vertical axis here T_T
+    void expand_within(GameState& state, const Bitboard& reachable, DepthFrame& frame, size_t threshold,
+                       size_t& next_threshold) {
+        if (!tracker.charge_expansion()) {
+            tracker.charge_table(frame_bytes(frame)); // `leave` gives it back
+            return; // no children, the search loop notices the budget is gone and stops
+        }
+        ++statistics.expanded_nodes;
+        for (Push& push : pushes(state, reachable)) {
+            GameState::PushUndo undo = state.make_push(push.box, push.move, push.length);
+            push.score = heuristic.lower_bound(state);
+            state.unmake_push(undo);
+            if (push.score == Heuristic::DEADLOCK) {
+                continue;
+            }
+            size_t total = frame.pushes + push.length + push.score;
+            if (total > threshold) {
+                next_threshold = std::min(next_threshold, total); // the smallest overflow becomes the next bound
+                continue;
+            }
+            frame.children.push_back(std::move(push));
+        }
+        std::stable_sort(frame.children.begin(), frame.children.end(), [] (const auto& a, const auto& b) -> bool {
+            return a.score < b.score;
+        });
+        statistics.generated_nodes += frame.children.size();
+        tracker.charge_table(frame_bytes(frame));
+    }
+
+    std::vector<Move> rebuild_solution(const GameState& initial, const SearchNode* node) const {
+        return walk_pushes(initial, push_chain(node));
+    }
 
-        if (is_horizontal_lock) {
-            int64_t wall_delta = static_cast<int64_t>(wall.x) - static_cast<int64_t>(box.x);
+    // Pushes from the start to the node, in the order they were made
+    static std::vector<Push> push_chain(const SearchNode* node) {
+        std::vector<Push> chain;
+        for (; node && node->push != Move::NONE; node = node->parent) {
+            chain.push_back(Push{node->box, node->push, node->length});
+        }
+        std::reverse(chain.begin(), chain.end());
+        return chain;
+    }
 
-            // slide right
-            for (size_t y = box.y + 1; y < level.dimensions().y; ++y) {
-                Point box_level_pos { box.x, y };
-                Point wall_level_pos { box.x + wall_delta, y };
-                auto o_box_level_cell = level.at(box_level_pos);
-                auto o_wall_level_cell = level.at(wall_level_pos);
-                // #    x        .  #
-                // ##################
-                if (o_box_level_cell && o_box_level_cell->type == CellType::TARGET) {
-                    return false; // solvable
-                }
+    // Legal pushes; a state without any is a proven dead end, and the boxes responsible for it are learned.
+    // `reachable` is the player's area in the state: searches find it once per state and share it with their closed set.
+    std::vector<Push> pushes(const GameState& state, const Bitboard& reachable) {
+        std::vector<Push> result = legal_pushes(state, reachable);
+        if (result.empty() && !state.is_victory()) {
+            learn(state, reachable);
+        }
+        return result;
+    }
 
-                // #   x #          #
-                // ##################
-                if (o_box_level_cell && o_box_level_cell->type == CellType::WALL) {
-                    break; // potentially unsolvable lock; continue in another direction
-                }
+    // `proof` is set for the searches proving patterns and placements dead, see `exhausts`. They try pushes into
+    // PI-corrals as well, and only use the placements decided already: deciding one there could recurse without end.
+    std::vector<Push> legal_pushes(const GameState& state, const Bitboard& reachable, bool proof = false) const {
+        auto pushable_boxes = state.all_pushable_boxes();
+        if (pushable_boxes.empty()) {
+            return {}; // no solution
+        }
+        std::vector<Push> result;
+        result.reserve(pushable_boxes.size());
+        Bitboard boxes = state.box_board();
 
-                // #    x           #
-                // #########  #######
-                if (o_wall_level_cell && o_wall_level_cell->type != CellType::WALL) {
-                    return false; // solvable
+        // For each crate analyze from which side it can be pushed. Pushing is possible if two conditions are satisfied:
+        // 1. push-position provided by game state with respect to walls and other crates
+        // 2. position before the crate is reachable by player (or player already stands there)
+        // Pushes into a dead placement of the level's table or freezing boxes off targets are dropped right away.
+        // A push into a tunnel goes on through it, and one into a goal room may also go straight on to a target.
+        prioritise_untargeted_boxes(pushable_boxes);
+        for (const PushableBox& pushable_box : pushable_boxes) {
+            for (Move move : pushable_box.allowed_moves) { // (1) valid push positions from game state
+                Push push{pushable_box.crate_pos, move};
+                if (!reachable.test(level.index(push.push_position()))) { // (2) one flood fill for the whole state
+                    continue;
                 }
-            }
-            // slide left
-            for (size_t y = box.y - 1; y >= 0; --y) {
-                Point box_level_pos { box.x, y };
-                Point wall_level_pos { box.x + wall_delta, y };
-                auto o_box_level_cell = level.at(box_level_pos);
-                auto o_wall_level_cell = level.at(wall_level_pos);
-                // # .  x           #
-                // ##################
-                if (o_box_level_cell && o_box_level_cell->type == CellType::TARGET) {
-                    return false; // solvable
+                size_t from = level.index(push.box);
+                push.length = tunnel_length(boxes, from, move);
+                if (!is_deadlocking(boxes, from, push, proof)) {
+                    result.push_back(push);
                 }
-
-                // #   # x          #
-                // ##################
-                if (o_box_level_cell && o_box_level_cell->type == CellType::WALL) {
-                    return true; // unsolvable
+                size_t room_length = goal_room_length(boxes, from, move);
+                if (room_length > push.length) {
+                    push.length = room_length;
+                    if (!is_deadlocking(boxes, from, push, proof)) {
+                        result.push_back(push);
+                    }
                 }
+            }
+        }
+        if (!proof) {
+            keep_corral_pushes(state, reachable, result);
+        }
+        return result;
+    }
 
-                // #    x           #
-                // ##  ##############
-                if (o_wall_level_cell && o_wall_level_cell->type != CellType::WALL) {
-                    return false; // solvable
-                }
+    bool is_deadlocking(Bitboard& boxes, size_t from, const Push& push, bool proof) const {
+        size_t to = from + static_cast<std::ptrdiff_t>(push.length) * level.offset(push.move);
+        boxes.reset(from);
+        boxes.set(to);
+        bool deadlock = (proof ? small_deadlocks->touches_dead(boxes, to) : touches_dead_placement(boxes, to))
+                        || is_freeze_deadlock(boxes, to);
+        boxes.reset(to);
+        boxes.set(from);
+        return deadlock;
+    }
+
+    // Cells a push takes the box: one, or more while both the box and the player behind it are in a tunnel and
+    // the box is off targets. There is nothing else to do with the box but push it on, and stopping halfway would
+    // only leave the tunnel blocked.
+    size_t tunnel_length(const Bitboard& boxes, size_t from, Move move) const {
+        size_t length = 1;
+        for (size_t to = level.neighbour(from, move); ; to = level.neighbour(to, move), ++length) {
+            size_t next = level.neighbour(to, move);
+            if (level.is_target(to) || !level.is_tunnel(to, move) || !level.is_tunnel(level.neighbour(to, opposite(move)), move)
+                || level.is_wall(next) || boxes.test(next) || level.is_dead(next)) {
+                return length;
             }
-            return false;
-        } else { // vertical lock
-            int64_t wall_delta = static_cast<int64_t>(wall.y) - static_cast<int64_t>(box.y);
-
-            // slide down
-            for (size_t x = box.x + 1; x < level.dimensions().x; ++x) {
-                Point box_level_pos { x, box.y };
-                Point wall_level_pos { x, box.y + wall_delta };
-                auto o_box_level_cell = level.at(box_level_pos);
-                auto o_wall_level_cell = level.at(wall_level_pos);
-                // ##
-                // #
-                // #x
-                // #
-                // #.
-                // ##
-                if (o_box_level_cell && o_box_level_cell->type == CellType::TARGET) {
-                    return false; // solvable
-                }
+        }
+    }
 
-                // ##
-                // #
-                // #x
-                // #
-                // #
-                // ##
-                if (o_box_level_cell && o_box_level_cell->type == CellType::WALL) {
-                    break; // potentially unsolvable lock; continue in another direction
+    // Macro push from the entrance of a goal room into it: straight on to the farthest target in line, which fills
+    // the room from the back. 0 if there is no such target.
+    size_t goal_room_length(const Bitboard& boxes, size_t from, Move move) const {
+        if (!level.enters_goal_room(from, move)) {
+            return 0;
+        }
+        size_t length = 0;
+        size_t target_length = 0;
+        for (size_t to = level.neighbour(from, move); !level.is_wall(to) && !boxes.test(to); to = level.neighbour(to, move)) {
+            ++length;
+            if (level.is_target(to)) {
+                target_length = length;
+            }
+        }
+        return target_length;
+    }
+
+    // PI-corral pruning. A corral is an area the player can't reach, closed off by boxes. If every push its boxes could
+    // ever get from outside goes into the corral (I) and the player can make each of these pushes right away (P), then
+    // any other push can wait: nothing done outside opens the corral, so a solution has to push one of its boxes in
+    // sooner or later anyway. Unless all the corral's boxes are on targets already, only the pushes of its boxes are
+    // kept, of the corral which needs the fewest of them. Empty targets inside don't count: with spare targets
+    // a solution may leave them empty.
+    void keep_corral_pushes(const GameState& state, const Bitboard& reachable, std::vector<Push>& result) const {
+        Bitboard unreached = level.floor();
+        unreached.and_not(reachable);
+        unreached.and_not(state.box_board());
+        Bitboard best_edge;
+        size_t best_pushes = result.size();
+        for (size_t seed = unreached.first(); seed != Bitboard::NONE; seed = unreached.first()) {
+            Bitboard corral = Bitboard::flood_fill(seed, unreached, level.row_stride());
+            unreached.and_not(corral);
+            Bitboard edge(level.cell_count());
+            if (!is_pi_corral(state, reachable, corral, edge)) {
+                continue;
+            }
+            size_t pushes = static_cast<size_t>(std::count_if(result.begin(), result.end(), [&] (const Push& push) {
+                return edge.test(level.index(push.box));
+            }));
+            if (pushes > 0 && pushes < best_pushes) {
+                best_pushes = pushes;
+                best_edge = edge;
+            }
+        }
+        if (best_pushes < result.size()) {
+            std::erase_if(result, [&] (const Push& push) {
+                return !best_edge.test(level.index(push.box));
+            });
+        }
+    }
+
+    // Fills `edge` with the boxes next to the corral. Pushes onto walls or dead cells never count, and a box blocking
+    // the player's way to a push could move away later, so it makes the corral fail the checks.
+    bool is_pi_corral(const GameState& state, const Bitboard& reachable, const Bitboard& corral, Bitboard& edge) const {
+        bool done = true; // every box of the corral is on a target
+        bool pi = true;
+        state.box_board().for_each([&] (size_t box) {
+            if (!pi || std::none_of(Level::MOVES.begin(), Level::MOVES.end(), [&] (Move move) {
+                return corral.test(level.neighbour(box, move));
+            })) {
+                return;
+            }
+            edge.set(box);
+            done = done && level.is_target(box);
+            for (Move move : Level::MOVES) {
+                size_t to = level.neighbour(box, move);
+                size_t from = level.neighbour(box, opposite(move));
+                if (level.is_wall(to) || level.is_dead(to) || level.is_wall(from) || corral.test(from)) {
+                    continue; // no push, or one that needs the player inside the corral already
+                }
+                if (!corral.test(to) || !reachable.test(from)) {
+                    pi = false;
                 }
+            }
+        });
+        return pi && !done && edge.first() != Bitboard::NONE;
+    }
+
+    std::vector<NextState> successors(const GameState& state, const Bitboard& reachable) {
+        std::vector<Push> candidates = pushes(state, reachable);
+        std::vector<NextState> next_states;
+        next_states.reserve(candidates.size());
+        for (const Push& push : candidates) {
+            GameState next_state = state;
+            next_state.make_push(push.box, push.move, push.length);
+            next_states.emplace_back(next_state, push);
+        }
+        return next_states;
+    }
+
+    void prioritise_untargeted_boxes(std::vector<PushableBox>& boxes) const {
+        // stable, so boxes keep their cell order within both groups
+        std::stable_sort(boxes.begin(), boxes.end(), [&] (const auto& a, const auto &b) -> bool {
+            bool a_ok = level.is_target(level.index(a.crate_pos));
+            bool b_ok = level.is_target(level.index(b.crate_pos));
+            return !a_ok && b_ok;
+        });
+    }
 
-                // ##
-                // #
-                // #x
-                // #
-                //
-                // ##
-                if (o_wall_level_cell && o_wall_level_cell->type != CellType::WALL) {
-                    return false; // solvable
+    // Cheap checks go first; states only the matching finds dead are counted in `stats`
+    bool is_unsolvable(const GameState& state, SolverStats& stats) const {
+        // boxes on dead cells take a single pass over the words of the board
+        if (state.box_board().count_common(level.dead()) != 0) {
+            return true;
+        }
+        const Bitboard& boxes = state.box_board();
+        for (size_t box = boxes.first(); box != Bitboard::NONE; box = boxes.next(box)) {
+            if (!level.is_target(box) && is_unmovable_quad(box, boxes)) {
+                return true;
+            }
+        }
+        if (!assignment.assignable(state)) {
+            ++stats.matching_cuts;
+            return true;
+        }
+        if (patterns.matches(state.box_board())) {
+            ++stats.pattern_cuts;
+            return true;
+        }
+        return false;
+    }
+
+    void learn(const GameState& state, const Bitboard& reachable) {
+        // The player can't push anything, so the boxes next to the player's area are to blame, along with the boxes
+        // blocking them. Those are proven dead from every area the player could be in, and then any box whose
+        // removal keeps them dead is dropped, which leaves a pattern that later states hardly ever hold by chance.
+        if (state.box_board().count_common(level.dead()) != 0) {
+            return; // dead cells catch it already
+        }
+        Bitboard suspects(level.cell_count());
+        state.box_board().for_each([&] (size_t box) {
+            for (Move move : Level::MOVES) {
+                if (reachable.test(level.neighbour(box, move))) {
+                    suspects.set(box);
                 }
             }
-            // slide up
-            for (size_t x = box.x - 1; x >= 0; --x) {
-                Point box_level_pos { x, box.y };
-                Point wall_level_pos { x, box.y + wall_delta };
-                auto o_box_level_cell = level.at(box_level_pos);
-                auto o_wall_level_cell = level.at(wall_level_pos);
-                // ##
-                // #.
-                // #x
-                // #
-                // #
-                // ##
-                if (o_box_level_cell && o_box_level_cell->type == CellType::TARGET) {
-                    return false; // solvable
+        });
+        Bitboard blockers(level.cell_count());
+        suspects.for_each([&] (size_t box) {
+            for (Move move : Level::MOVES) {
+                if (size_t next = level.neighbour(box, move); state.has_box(next)) {
+                    blockers.set(next);
                 }
+            }
+        });
+        suspects |= blockers;
+        if (suspects.count() > PATTERN_BOXES || !proves_dead(suspects)) {
+            return;
+        }
+        for (size_t box = suspects.first(); box != Bitboard::NONE; box = suspects.next(box)) {
+            suspects.reset(box);
+            if (!proves_dead(suspects)) {
+                suspects.set(box);
+            }
+        }
+        patterns.add(suspects);
+    }
+
+    // `is_dead_pattern`, but a set of boxes that was found alive (or too large to prove) isn't tried again: dead ends
+    // often have the same boxes to blame, and each proof is up to PATTERN_NODES nodes per player area.
+    // A proof cut short by the budget says nothing about the boxes and isn't remembered.
+    bool proves_dead(const Bitboard& suspects) {
+        {
+            std::lock_guard lock(unproven_mutex);
+            if (unproven.contains(suspects)) {
+                return false;
+            }
+        }
+        if (is_dead_pattern(suspects)) {
+            return true;
+        }
+        if (!tracker.is_exhausted()) {
+            std::lock_guard lock(unproven_mutex);
+            unproven.insert(suspects);
+        }
+        return false;
+    }
+
+    // Whether the boxes can't be solved from any area the player may stand in, other boxes removed. Decided by
+    // bounded exhaustive searches, so a pattern too large to prove within PATTERN_NODES is taken for alive.
+    bool is_dead_pattern(const Bitboard& box_cells) const {
+        std::vector<Point> boxes;
+        box_cells.for_each([&] (size_t box) {
+            boxes.push_back(level.point(box));
+        });
+        if (boxes.empty()) {
+            return false;
+        }
+        GameState probe(level, boxes.front(), boxes);
+        if (probe.is_victory()) {
+            return false;
+        }
+        for (Point player : area_representatives(probe)) {
+            if (level.interior_index(player) != Level::NO_INDEX && !exhausts(GameState(level, player, boxes))) {
+                return false;
+            }
+        }
+        return true;
+    }
 
-                // ##
-                // #
-                // #x
-                // #
-                // #
-                // ##
-                if (o_box_level_cell && o_box_level_cell->type == CellType::WALL) {
-                    return true; // unsolvable
+    // Depth-first over the whole state space of the start; false if a victory is found or the search is cut short.
+    // Successors with the smallest lower bound go first, so that boxes which aren't dead find their way quickly.
+    // The start has fewer boxes than the level has targets, and a wrong proof would be stored and cut solvable
+    // states in every later search, so every legal push is tried here, PI-corrals or not.
+    bool exhausts(const GameState& start) const {
+        VisitedStates seen(level);
+        std::vector<GameState> stack{start};
+        SolverStats ignored;
+        size_t nodes = 0;
+        while (!stack.empty()) {
+            GameState state = std::move(stack.back());
+            stack.pop_back();
+            if (state.is_victory()) {
+                return false;
+            }
+            Bitboard reachable = state.reachable();
+            if (!seen.insert(state, state.canonical_player_pos(reachable)) || is_unsolvable(state, ignored)) {
+                continue;
+            }
+            if (++nodes > PATTERN_NODES || tracker.is_exhausted()) {
+                return false;
+            }
+            std::vector<Push> candidates = legal_pushes(state, reachable, true);
+            for (Push& push : candidates) {
+                GameState::PushUndo undo = state.make_push(push.box, push.move, push.length);
+                push.score = heuristic.lower_bound(state);
+                state.unmake_push(undo);
+            }
+            std::stable_sort(candidates.begin(), candidates.end(), [] (const auto& a, const auto& b) -> bool {
+                return a.score > b.score; // the stack pops the last one first
+            });
+            for (const Push& push : candidates) {
+                if (push.score != Heuristic::DEADLOCK) {
+                    stack.push_back(state);
+                    stack.back().make_push(push.box, push.move, push.length);
                 }
+            }
+        }
+        return true;
+    }
 
-                // ##
-                //
-                // #x
-                // #
-                // #
-                // ##
-                if (o_wall_level_cell && o_wall_level_cell->type != CellType::WALL) {
-                    return false; // solvable
+    bool is_unmovable_quad(size_t box, const Bitboard& boxes) const {
+        size_t r = level.neighbour(box, Move::D);
+        size_t d = level.neighbour(box, Move::S);
+        size_t rd = level.neighbour(d, Move::D);
+        bool is_quad = boxes.test(r) && boxes.test(d) && boxes.test(rd);
+        if (is_quad) {
+            for (size_t p : {box, r, d, rd}) {
+                if (!level.is_target(p)) {
+                    return true; // boxes form a 2x2 quad and at least one is not on target cell - that's a deadlock
                 }
             }
-            return false;
         }
+        return false;
+    }
+
+    // Whether the box just pushed to `box` is frozen, i.e. unable to move along either axis ever again, while it or some
+    // box frozen along with it is off target. Only the boxes around the moved one are looked at.
+    bool is_freeze_deadlock(const Bitboard& boxes, size_t box) const {
+        Bitboard assumed(level.cell_count()); // boxes on the way to the current one, taken for walls
+        Bitboard movable(level.cell_count()); // boxes already found able to move
+        std::vector<size_t> frozen;
+        return is_frozen(boxes, box, assumed, movable, frozen)
+               && std::any_of(frozen.begin(), frozen.end(), [&] (size_t b) { return !level.is_target(b); });
     }
 
-    static bool validate_state_uniqueness(const GameState& state, NonIsomorphicStates& states) {
-        auto reduced_state = state.reduced_state();
-        std::vector<GameState>& states_with_same_box_positions = states[reduced_state];
-        if (states_with_same_box_positions.empty()) {
-            states_with_same_box_positions.reserve(SUBSTATES_CAPACITY);
-            states_with_same_box_positions.push_back(state);
-            return true; // state is unique, continue algorithm
+    // Whether the box just pushed to `box` completes a dead placement. Placements met for the first time are proven
+    // on the spot, within the search's budget: one whose proof was cut short by it is left for a later search.
+    bool touches_dead_placement(const Bitboard& boxes, size_t box) const {
+        return small_deadlocks->touches_dead(boxes, box, [&] (size_t anchor, size_t shape) {
+            return decide_placement(anchor, shape);
+        });
+    }
+
+    DeadlockTable::Verdict decide_placement(size_t anchor, size_t shape) const {
+        DeadlockTable::Verdict verdict = DeadlockTable::ALIVE;
+        if (is_small_candidate(anchor, shape) && is_dead_pattern(placement(anchor, shape))) {
+            verdict = DeadlockTable::DEAD;
+        } else if (tracker.is_exhausted()) {
+            return DeadlockTable::UNDECIDED;
         }
+        small_deadlocks->decide(anchor, shape, verdict);
+        return verdict;
+    }
 
-        for (const GameState& potentially_isomorphic_state : states_with_same_box_positions) {
-            if (are_isomorphic(state, potentially_isomorphic_state)) {
-                return false; // non unique state that differs only by mutually reachable player positions. Abort
+    // Placements on dead cells are caught without the table, and a triple holding a dead pair needs no verdict
+    // of its own. The pairs of a triple are decided first, so that its proof skips pushes into them.
+    bool is_small_candidate(size_t anchor, size_t shape) const {
+        const DeadlockTable::Shape& s = small_deadlocks->shapes()[shape];
+        for (size_t k = 0; k < s.boxes; ++k) {
+            size_t cell = anchor + s.offsets[k];
+            if (cell >= level.cell_count() || level.interior_index(level.point(cell)) == Level::NO_INDEX
+                || level.is_dead(cell)) {
+                return false;
             }
         }
-        states_with_same_box_positions.push_back(state);
-        return true; // we have some state with same box positions yet player position differs significantly. Continue
+        for (size_t k = 0; k < s.boxes && s.boxes == 3; ++k) {
+            Bitboard pair = placement(anchor, shape);
+            pair.reset(anchor + s.offsets[k]); // no triple holds two boxes, so deciding the pair can't come back here
+            size_t box = pair.first();
+            if (touches_dead_placement(pair, box)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    Bitboard placement(size_t anchor, size_t shape) const {
+        Bitboard boxes(level.cell_count());
+        const DeadlockTable::Shape& s = small_deadlocks->shapes()[shape];
+        for (size_t k = 0; k < s.boxes; ++k) {
+            boxes.set(anchor + s.offsets[k]);
+        }
+        return boxes;
+    }
+
+    bool is_frozen(const Bitboard& boxes, size_t box, Bitboard& assumed, Bitboard& movable,
+                   std::vector<size_t>& frozen) const {
+        // boxes found frozen are only kept if the box depending on them turns out frozen as well
+        size_t mark = frozen.size();
+        assumed.set(box);
+        bool result = is_blocked(boxes, box, Move::W, assumed, movable, frozen)
+                      && is_blocked(boxes, box, Move::A, assumed, movable, frozen);
+        assumed.reset(box);
+        if (result) {
+            frozen.push_back(box);
+        } else {
+            frozen.resize(mark);
+            movable.set(box);
+        }
+        return result;
     }
 
-    static bool are_isomorphic(const GameState& s1, const GameState& s2) {
-        if (s1.player_pos() == s2.player_pos()) {
+    // Whether the box can't move along the axis of `axis`: a wall or a box taken for a wall on either side,
+    // dead cells on both sides, or a frozen box on either side
+    bool is_blocked(const Bitboard& boxes, size_t box, Move axis, Bitboard& assumed, Bitboard& movable,
+                    std::vector<size_t>& frozen) const {
+        size_t one = level.neighbour(box, axis);
+        size_t other = level.neighbour(box, opposite(axis));
+        if (level.is_wall(one) || level.is_wall(other) || assumed.test(one) || assumed.test(other)) {
             return true;
         }
+        if (level.is_dead(one) && level.is_dead(other)) {
+            return true; // moving along this axis is a deadlock anyway
+        }
+        for (size_t side : {one, other}) {
+            if (boxes.test(side) && !movable.test(side) && is_frozen(boxes, side, assumed, movable, frozen)) {
+                return true;
+            }
+        }
+        return false;
+    }
 
-        return Paths::plot_path(s1.player_pos(), s2.player_pos(), s1.f_adjacent_walkable()).has_value();
+    bool improve_closed(const GameState& state, Point canonical_player, size_t pushes, CostedStates& closed) {
+        // a state is worth expanding if it's new or if it was reached with more pushes before
+        auto [best, inserted] = closed.try_emplace(state, canonical_player, static_cast<uint32_t>(pushes));
+        if (inserted) {
+            tracker.charge_table(closed.bytes_per_state());
+            return true;
+        }
+        if (best <= pushes) {
+            return false;
+        }
+        best = static_cast<uint32_t>(pushes);
+        return true;
     }
 };
 
@@ -0,0 +1,44 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Fixed-size, lossy memory of visited states. Each key owns exactly one slot and a newcomer simply overwrites
+// whatever was stored there, so the table never grows: forgetting a state only costs a repeated search of it.
+class TranspositionTable {
+public:
+    explicit TranspositionTable(size_t bytes) : entries(slots_for(bytes)), mask(entries.size() - 1) {}
+
+    // Answers whether the state was already reached during the given iteration with no more pushes than now.
+    // If not, the state is remembered in place of the previous slot owner.
+    bool visited(uint64_t key, uint32_t pushes, uint32_t iteration) {
+        Entry& entry = entries[key & mask];
+        if (entry.iteration == iteration && entry.key == key && entry.pushes <= pushes) {
+            return true;
+        }
+        entry = Entry{key, pushes, iteration};
+        return false;
+    }
+
+    size_t size_in_bytes() const {
+        return entries.size() * sizeof(Entry);
+    }
+private:
+    struct Entry {
+        uint64_t key = 0;
+        uint32_t pushes = 0;
+        uint32_t iteration = 0; // 0 marks a slot that was never written, iterations are counted from 1
+    };
+
+    std::vector<Entry> entries;
+    size_t mask;
+
+    static size_t slots_for(size_t bytes) {
+        // largest power of two that fits into the budget, but at least one slot
+        size_t slots = 1;
+        while (slots * 2 * sizeof(Entry) <= bytes) {
+            slots *= 2;
+        }
+        return slots;
+    }
+};
@@ -42,7 +42,7 @@ int main(int argc, const char** argv) {
         interLayer.manual_loop();
     } else {
         Solver solver(level);
-        interLayer.execute_commands(solver.solve(game));
+        interLayer.execute_commands(solver.solve(game).moves);
     }
     return 0;
 }
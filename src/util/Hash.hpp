@@ -1,6 +1,7 @@
 #pragma once
 #include <cstddef>
 #include <functional>
+#include <cstdint>
 
 #define HASH_SUPPORT(clazz) namespace std { template<> struct hash<clazz> { \
     inline size_t operator()(const clazz& x) const { return x.hash(); } \
@@ -11,4 +12,13 @@ template <class T>
 inline size_t hash_combine(size_t s, const T& v) {
     static std::hash<T> h;
     return s ^ (h(v) + 0x9e3779b9 + (s<< 6) + (s>> 2));
-}
\ No newline at end of file
+}
+
+// Finalizer of splitmix64: spreads every input bit over the whole word, so keys built from small cell indices
+// can be combined with xor and used directly to address power-of-two tables.
+inline uint64_t mix_hash(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
@@ -4,6 +4,53 @@
 #include <game/GameState.hpp>
 #include <logic/Paths.hpp>
 #include <logic/Solver.hpp>
+#include <logic/Portfolio.hpp>
+
+#include <unordered_set>
+#include <type_traits>
+
+size_t count_pushes(GameState game, const std::vector<Move>& moves) {
+    size_t pushes = 0;
+    for (Move move : moves) {
+        auto boxes_before = game.box_positions();
+        game.issue_order(move);
+        if (boxes_before != game.box_positions()) {
+            ++pushes;
+        }
+    }
+    return pushes;
+}
+
+// Whether the boxes alone can be solved with the player starting anywhere inside the level, by brute force over moves
+bool solvable_from_anywhere(const Level& level, const Bitboard& box_cells) {
+    std::vector<Point> boxes;
+    box_cells.for_each([&] (size_t i) {
+        boxes.push_back(level.point(i));
+    });
+    std::unordered_set<GameState> seen;
+    std::vector<GameState> stack;
+    for (size_t i = 0; i < level.cell_count(); ++i) {
+        if (level.interior_index(i) != Level::NO_INDEX && !box_cells.test(i)) {
+            stack.emplace_back(level, level.point(i), boxes);
+            seen.insert(stack.back());
+        }
+    }
+    while (!stack.empty()) {
+        GameState state = stack.back();
+        stack.pop_back();
+        if (state.is_victory()) {
+            return true;
+        }
+        for (Move move : Level::MOVES) {
+            GameState next = state;
+            next.issue_order(move);
+            if (seen.insert(next).second) {
+                stack.push_back(next);
+            }
+        }
+    }
+    return false;
+}
 
 TEST_CASE("Path finding - path exists") {
     // x - box
@@ -30,8 +77,8 @@ TEST_CASE("Path finding - path exists") {
     std::string expected_moves_a = "sdssssaaaaawwddd";
     std::string expected_moves_b = "dddssssssddwwwddddwwdddwwaa";
 
-    auto path_a = Paths::plot_path(player_position, goal_a, game.f_adjacent_walkable());
-    auto path_b = Paths::plot_path(player_position, goal_b, game.f_adjacent_walkable());
+    auto path_a = Paths::plot_path(level, player_position, goal_a, game.walkable());
+    auto path_b = Paths::plot_path(level, player_position, goal_b, game.walkable());
     REQUIRE(path_a);
     REQUIRE(path_b);
     REQUIRE(Paths::as_string(*path_a) == expected_moves_a);
@@ -61,8 +108,8 @@ TEST_CASE("Path finding - goal unreachable") {
     Point goal_b {1, 16};
     GameState game(level, player_position, {{5, 6}, {1, 10}});
 
-    auto path_a = Paths::plot_path(player_position, goal_a, game.f_adjacent_walkable());
-    auto path_b = Paths::plot_path(player_position, goal_b, game.f_adjacent_walkable());
+    auto path_a = Paths::plot_path(level, player_position, goal_a, game.walkable());
+    auto path_b = Paths::plot_path(level, player_position, goal_b, game.walkable());
     REQUIRE(!path_a);
     REQUIRE(!path_b);
 }
@@ -90,8 +137,8 @@ TEST_CASE("Path finding - trivials") {
     Point goal_b  = player_position;
     GameState game(level, player_position, {{5, 6}, {1, 10}});
 
-    auto path_a = Paths::plot_path(player_position, goal_a, game.f_adjacent_walkable());
-    auto path_b = Paths::plot_path(player_position, goal_b, game.f_adjacent_walkable());
+    auto path_a = Paths::plot_path(level, player_position, goal_a, game.walkable());
+    auto path_b = Paths::plot_path(level, player_position, goal_b, game.walkable());
     REQUIRE(path_a);
     REQUIRE(path_b);
     REQUIRE(Paths::as_string(*path_a) == "s");
@@ -120,7 +167,7 @@ TEST_CASE("Path finding - out of boundaries") {
     Point goal {30, 60};
     GameState game(level, player_position, {{5, 6}, {1, 10}});
 
-    auto path = Paths::plot_path(player_position, goal, game.f_adjacent_walkable());
+    auto path = Paths::plot_path(level, player_position, goal, game.walkable());
     REQUIRE(!path);
 }
 
@@ -143,7 +190,7 @@ TEST_CASE("Solving - trivial straight line") {
     std::string expected_moves = "ssssss";
 
     Solver solver(level);
-    auto solution = solver.solve(game);
+    auto solution = solver.solve(game).moves;
     REQUIRE(Paths::as_string(solution) == expected_moves);
 }
 
@@ -166,7 +213,7 @@ TEST_CASE("Solving - trivial no solution") {
     std::string expected_moves = "";
 
     Solver solver(level);
-    auto solution = solver.solve(game);
+    auto solution = solver.solve(game).moves;
     REQUIRE(Paths::as_string(solution) == expected_moves);
 }
 
@@ -188,7 +235,7 @@ TEST_CASE("Solving - trivial straight line two boxes") {
     GameState game(level, player_position, {{3, 1}, {6, 1}});
 
     Solver solver(level);
-    auto solution = solver.solve(game);
+    auto solution = solver.solve(game).moves;
     game.issue_orders(solution);
     REQUIRE(game.is_victory());
 }
@@ -213,7 +260,7 @@ TEST_CASE("Solving - trivial straight line unreachable box") {
     std::string expected_moves = "";
 
     Solver solver(level);
-    auto solution = solver.solve(game);
+    auto solution = solver.solve(game).moves;
     REQUIRE(Paths::as_string(solution) == expected_moves);
 }
 
@@ -237,7 +284,7 @@ TEST_CASE("Solving - trivial straight line pushable box no solution") {
     std::string expected_moves = "";
 
     Solver solver(level);
-    auto solution = solver.solve(game);
+    auto solution = solver.solve(game).moves;
     REQUIRE(Paths::as_string(solution) == expected_moves);
 }
 
@@ -252,7 +299,7 @@ TEST_CASE("Solving - trivial straight line two boxes horizontal") {
     GameState game(level, player_position, {{1, 4}, {1, 11}});
 
     Solver solver(level);
-    auto solution = solver.solve(game);
+    auto solution = solver.solve(game).moves;
     game.issue_orders(solution);
     REQUIRE(game.is_victory());
 }
@@ -275,7 +322,7 @@ TEST_CASE("Solving - retractable box") {
     GameState game(level, player_position, {{5, 2}});
 
     Solver solver(level);
-    auto solution = solver.solve(game);
+    auto solution = solver.solve(game).moves;
     game.issue_orders(solution);
     REQUIRE(game.is_victory());
 }
@@ -298,7 +345,7 @@ TEST_CASE("Solving - retractable box, two boxes") {
     GameState game(level, player_position, {{5, 2}, {3, 1}});
 
     Solver solver(level);
-    auto solution = solver.solve(game);
+    auto solution = solver.solve(game).moves;
     game.issue_orders(solution);
     REQUIRE(game.is_victory());
 }
@@ -317,7 +364,7 @@ TEST_CASE("Solving - moving box around") {
     GameState game(level, player_position, {{3, 2}});
 
     Solver solver(level);
-    auto solution = solver.solve(game);
+    auto solution = solver.solve(game).moves;
     game.issue_orders(solution);
     REQUIRE(game.is_victory());
 }
@@ -337,7 +384,7 @@ TEST_CASE("Solving - real level 1 box") {
     GameState game(level, player_position, {{3, 3}});
 
     Solver solver(level);
-    auto solution = solver.solve(game);
+    auto solution = solver.solve(game).moves;
     game.issue_orders(solution);
     REQUIRE(game.is_victory());
 }
@@ -357,7 +404,7 @@ TEST_CASE("Solving - real level 2 boxes") {
     GameState game(level, player_position, {{3, 3}, {3, 4}});
 
     Solver solver(level);
-    auto solution = solver.solve(game);
+    auto solution = solver.solve(game).moves;
     game.issue_orders(solution);
     REQUIRE(game.is_victory());
 }
@@ -377,7 +424,7 @@ TEST_CASE("Solving - real level 3 boxes") {
     GameState game(level, player_position, {{3, 3}, {3, 4}, {4, 3}});
 
     Solver solver(level);
-    auto solution = solver.solve(game);
+    auto solution = solver.solve(game).moves;
     game.issue_orders(solution);
     REQUIRE(game.is_victory());
 }
@@ -397,7 +444,7 @@ TEST_CASE("Solving - real level 3 boxes (variation)") {
     GameState game(level, player_position, {{3, 3}, {3, 4}, {4, 2}});
 
     Solver solver(level);
-    auto solution = solver.solve(game);
+    auto solution = solver.solve(game).moves;
     game.issue_orders(solution);
     REQUIRE(game.is_victory());
 }
@@ -417,7 +464,7 @@ TEST_CASE("Solving - real level 4 boxes") {
     GameState game(level, player_position, {{3, 3}, {3, 4}, {4, 2}, {4, 3}});
 
     Solver solver(level);
-    auto solution = solver.solve(game);
+    auto solution = solver.solve(game).moves;
     game.issue_orders(solution);
     REQUIRE(game.is_victory());
 }
@@ -445,7 +492,7 @@ TEST_CASE("Solving - real level canonical") {
                                             {6, 5}});
 
     Solver solver(level);
-    auto solution = solver.solve(game);
+    auto solution = solver.solve(game).moves;
     game.issue_orders(solution);
     REQUIRE(game.is_victory());
 }
@@ -480,7 +527,1062 @@ TEST_CASE("Solving - real level, trivial solution, many crates") {
         {5, 8}});
 
     Solver solver(level);
-    auto solution = solver.solve(game);
+    auto solution = solver.solve(game).moves;
+    game.issue_orders(solution);
+    REQUIRE(game.is_victory());
+}
+
+TEST_CASE("Heuristic - push distance lower bound") {
+    std::vector<std::string> map = {
+            "#####",
+            "#@  #",
+            "# x #",
+            "#   #",
+            "#  .#",
+            "#####",
+    };
+    Level level(map);
+    GameState game(level, {1, 1}, {{2, 2}});
+    GameState cornered(level, {1, 1}, {{1, 3}});
+
+    Heuristic heuristic(level);
+    REQUIRE(heuristic.lower_bound(game) == 3);
+    REQUIRE(heuristic.lower_bound(cornered) == Heuristic::DEADLOCK);
+}
+
+TEST_CASE("Solving A* - push-optimal solution") {
+    std::vector<std::string> map = {
+            "##############",
+            "########  ####",
+            "#          ###",
+            "# @xx ##   ..#",
+            "# xx   ##  ..#",
+            "#         ####",
+            "##############",
+    };
+    Level level(map);
+    Point player_position {3, 2};
+    GameState game(level, player_position, {{3, 3}, {3, 4}, {4, 2}, {4, 3}});
+
+    Solver greedy(level);
+    Solver optimal(level, SolverMode::A_STAR);
+    auto greedy_solution = greedy.solve(game).moves;
+    auto optimal_result = optimal.solve(game);
+    auto optimal_solution = optimal_result.moves;
+    REQUIRE(count_pushes(game, optimal_solution) == 46);
+    REQUIRE(count_pushes(game, optimal_solution) <= count_pushes(game, greedy_solution));
+    REQUIRE(optimal_result.stats.expanded_nodes > 0);
+
+    game.issue_orders(optimal_solution);
+    REQUIRE(game.is_victory());
+}
+
+TEST_CASE("Solving A* - no solution") {
+    std::vector<std::string> map = {
+            "###",
+            "#@#",
+            "# #",
+            "# #",
+            "#x#",
+            "# #",
+            "# #",
+            "###",
+            "#.#",
+            "###",
+    };
+    Level level(map);
+    GameState game(level, {1, 1}, {{4, 1}});
+
+    Solver solver(level, SolverMode::A_STAR);
+    REQUIRE(solver.solve(game).status == SolveStatus::UNSOLVABLE);
+}
+
+TEST_CASE("Solving IDA* - push-optimal solution") {
+    std::vector<std::string> map = {
+            "##############",
+            "########  ####",
+            "#          ###",
+            "# @xx ##   ..#",
+            "# xx   ##  ..#",
+            "#         ####",
+            "##############",
+    };
+    Level level(map);
+    Point player_position {3, 2};
+    GameState game(level, player_position, {{3, 3}, {3, 4}, {4, 2}, {4, 3}});
+
+    Solver solver(level, SolverMode::IDA_STAR);
+    auto result = solver.solve(game);
+    auto solution = result.moves;
+    REQUIRE(count_pushes(game, solution) == 46);
+
+    game.issue_orders(solution);
+    REQUIRE(game.is_victory());
+
+    // corral pruning leaves the level above without transpositions, this one still has them
+    std::vector<std::string> canonical_map = {
+            "########",
+            "###   ##",
+            "#.    ##",
+            "###  .##",
+            "#.##  ##",
+            "# # . ##",
+            "#  .  .#",
+            "#   .  #",
+            "########",
+    };
+    Level canonical_level(canonical_map);
+    GameState canonical(canonical_level, {2, 2}, {{2, 3}, {3, 4}, {4, 4}, {6, 1}, {6, 3}, {6, 4}, {6, 5}});
+    auto canonical_result = Solver(canonical_level, SolverMode::IDA_STAR).solve(canonical);
+    REQUIRE(canonical_result.stats.transposition_cuts > 0);
+    canonical.issue_orders(canonical_result.moves);
+    REQUIRE(canonical.is_victory());
+}
+
+TEST_CASE("Transposition table - lossy bounded storage") {
+    TranspositionTable table(64);
+    REQUIRE(table.size_in_bytes() <= 64);
+
+    REQUIRE(!table.visited(42, 5, 1));
+    REQUIRE(table.visited(42, 5, 1));
+    REQUIRE(table.visited(42, 7, 1));
+    REQUIRE(!table.visited(42, 3, 1)); // reached cheaper, has to be searched again
+    REQUIRE(!table.visited(42, 3, 2)); // new iteration forgets everything
+}
+
+TEST_CASE("Solving parallel - real level canonical") {
+    std::vector<std::string> map = {
+            "########",
+            "###   ##",
+            "#.    ##",
+            "###  .##",
+            "#.##  ##",
+            "# # . ##",
+            "#  .  .#",
+            "#   .  #",
+            "########",
+    };
+    Level level(map);
+    Point player_position {2, 2};
+    GameState game(level, player_position, {{2, 3},
+                                            {3, 4},
+                                            {4, 4},
+                                            {6, 1},
+                                            {6, 3},
+                                            {6, 4},
+                                            {6, 5}});
+
+    Solver solver(level, SolverMode::PARALLEL, 4);
+    auto solution = solver.solve(game).moves;
+    game.issue_orders(solution);
+    REQUIRE(game.is_victory());
+}
+
+TEST_CASE("Solving parallel - no solution") {
+    std::vector<std::string> map = {
+            "###",
+            "#@#",
+            "# #",
+            "# #",
+            "#x#",
+            "# #",
+            "# #",
+            "###",
+            "#.#",
+            "###",
+    };
+    Level level(map);
+    GameState game(level, {1, 1}, {{4, 1}});
+
+    Solver solver(level, SolverMode::PARALLEL, 4);
+    REQUIRE(solver.solve(game).status == SolveStatus::UNSOLVABLE);
+}
+
+TEST_CASE("Solving HDA* - push-optimal solution") {
+    std::vector<std::string> map = {
+            "##############",
+            "########  ####",
+            "#          ###",
+            "# @xx ##   ..#",
+            "# xx   ##  ..#",
+            "#         ####",
+            "##############",
+    };
+    Level level(map);
+    Point player_position {3, 2};
+    GameState game(level, player_position, {{3, 3}, {3, 4}, {4, 2}, {4, 3}});
+
+    Solver solver(level, SolverMode::HDA_STAR, 4);
+    auto solution = solver.solve(game).moves;
+    REQUIRE(count_pushes(game, solution) == 46);
+
+    game.issue_orders(solution);
+    REQUIRE(game.is_victory());
+}
+
+TEST_CASE("MPSC queue - every item is delivered once") {
+    MpscQueue<int> queue;
+    std::vector<std::thread> producers;
+    for (int p = 0; p < 4; ++p) {
+        producers.emplace_back([&queue, p] {
+            for (int i = 0; i < 1000; ++i) {
+                queue.push(p * 1000 + i);
+            }
+        });
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    std::vector<bool> received(4000, false);
+    size_t total = queue.drain([&] (int item) {
+        REQUIRE(!received[item]);
+        received[item] = true;
+    });
+    REQUIRE(total == 4000);
+}
+
+TEST_CASE("Pulling - reverse of a push") {
+    std::vector<std::string> map = {
+            "######",
+            "#    #",
+            "#    #",
+            "######",
+    };
+    Level level(map);
+    GameState game(level, {1, 2}, {{1, 3}});
+
+    REQUIRE(!game.issue_pull(Move::D)); // crate is in the way
+    REQUIRE(!game.issue_pull(Move::S)); // nothing to pull
+    REQUIRE(game.issue_pull(Move::A));
+    REQUIRE(game.player_pos() == Point{1, 1});
+    REQUIRE(game.has_box(level.index(Point{1, 2})));
+
+    game.issue_order(Move::D);
+    REQUIRE(game.player_pos() == Point{1, 2});
+    REQUIRE(game.has_box(level.index(Point{1, 3})));
+}
+
+TEST_CASE("Solving bidirectional - goal room") {
+    std::vector<std::string> map = {
+            "########",
+            "#@.....#",
+            "# xxxxx#",
+            "# .....#",
+            "# xxxxx#",
+            "#      #",
+            "########",
+    };
+    Level level(map);
+    GameState game(level, {1, 1}, {{2, 2}, {2, 3}, {2, 4}, {2, 5}, {2, 6},
+                                   {4, 2}, {4, 3}, {4, 4}, {4, 5}, {4, 6}});
+
+    Solver solver(level, SolverMode::BIDIRECTIONAL);
+    auto solution = solver.solve(game).moves;
+    game.issue_orders(solution);
+    REQUIRE(game.is_victory());
+}
+
+TEST_CASE("Solving bidirectional - no solution") {
+    std::vector<std::string> map = {
+            "###",
+            "#@#",
+            "# #",
+            "# #",
+            "#x#",
+            "# #",
+            "# #",
+            "###",
+            "#.#",
+            "###",
+    };
+    Level level(map);
+    GameState game(level, {1, 1}, {{4, 1}});
+
+    Solver solver(level, SolverMode::BIDIRECTIONAL);
+    REQUIRE(solver.solve(game).status == SolveStatus::UNSOLVABLE);
+}
+
+TEST_CASE("Solving portfolio - real level canonical") {
+    std::vector<std::string> map = {
+            "########",
+            "###   ##",
+            "#.    ##",
+            "###  .##",
+            "#.##  ##",
+            "# # . ##",
+            "#  .  .#",
+            "#   .  #",
+            "########",
+    };
+    Level level(map);
+    Point player_position {2, 2};
+    GameState game(level, player_position, {{2, 3},
+                                            {3, 4},
+                                            {4, 4},
+                                            {6, 1},
+                                            {6, 3},
+                                            {6, 4},
+                                            {6, 5}});
+
+    Portfolio portfolio(level);
+    auto solution = portfolio.solve(game).moves;
+    REQUIRE(portfolio.winning_strategy());
     game.issue_orders(solution);
     REQUIRE(game.is_victory());
+}
+
+TEST_CASE("Solving portfolio - exhausted race keeps its statistics") {
+    std::vector<std::string> map = {
+            "##############",
+            "########  ####",
+            "#          ###",
+            "# @xx ##   ..#",
+            "# xx   ##  ..#",
+            "#         ####",
+            "##############",
+    };
+    Level level(map);
+    GameState game(level, {3, 2}, {{3, 3}, {3, 4}, {4, 2}, {4, 3}});
+
+    Portfolio portfolio(level);
+    SearchBudget budget;
+    budget.max_expanded_nodes = 10;
+    auto result = portfolio.solve(game, budget);
+    REQUIRE(result.status == SolveStatus::BUDGET_EXHAUSTED);
+    REQUIRE(!portfolio.winning_strategy());
+    // every racer expands up to its own budget, and all of that work is reported
+    REQUIRE(result.stats.expanded_nodes > 10);
+    REQUIRE(result.stats.expanded_nodes <= 10 * Portfolio::default_strategies().size());
+    REQUIRE(result.stats.generated_nodes > 0);
+    REQUIRE(result.stats.table_bytes > 0);
+}
+
+TEST_CASE("Solving - cancelled search gives up") {
+    std::vector<std::string> map = {
+            "##############",
+            "########  ####",
+            "#          ###",
+            "# @xx ##   ..#",
+            "# xx   ##  ..#",
+            "#         ####",
+            "##############",
+    };
+    Level level(map);
+    GameState game(level, {3, 2}, {{3, 3}, {3, 4}, {4, 2}, {4, 3}});
+
+    SearchBudget budget;
+    budget.cancellation.cancel();
+    for (SolverMode mode : {SolverMode::GREEDY_DFS, SolverMode::A_STAR, SolverMode::IDA_STAR,
+                            SolverMode::PARALLEL, SolverMode::HDA_STAR, SolverMode::BIDIRECTIONAL}) {
+        Solver solver(level, mode, 2);
+        auto result = solver.solve(game, budget);
+        REQUIRE(result.status == SolveStatus::BUDGET_EXHAUSTED);
+        REQUIRE(result.moves.empty());
+        REQUIRE(result.stats.expanded_nodes == 0);
+    }
+}
+
+TEST_CASE("Solving - node and memory budgets") {
+    std::vector<std::string> map = {
+            "##############",
+            "########  ####",
+            "#          ###",
+            "# @xx ##   ..#",
+            "# xx   ##  ..#",
+            "#         ####",
+            "##############",
+    };
+    Level level(map);
+    GameState game(level, {3, 2}, {{3, 3}, {3, 4}, {4, 2}, {4, 3}});
+
+    for (SolverMode mode : {SolverMode::GREEDY_DFS, SolverMode::A_STAR, SolverMode::IDA_STAR,
+                            SolverMode::PARALLEL, SolverMode::HDA_STAR, SolverMode::BIDIRECTIONAL}) {
+        Solver solver(level, mode, 2);
+
+        SearchBudget nodes;
+        nodes.max_expanded_nodes = 10;
+        auto result = solver.solve(game, nodes);
+        REQUIRE(result.status == SolveStatus::BUDGET_EXHAUSTED);
+        REQUIRE(result.stats.expanded_nodes <= 10);
+
+        SearchBudget memory;
+        memory.max_table_bytes = 512;
+        auto constrained = solver.solve(game, memory);
+        REQUIRE(constrained.status == SolveStatus::BUDGET_EXHAUSTED);
+        if (mode == SolverMode::IDA_STAR) { // shrinks its transposition table to fit instead
+            SearchBudget small;
+            small.max_table_bytes = 64 * 1024;
+            auto fitted = solver.solve(game, small);
+            REQUIRE(fitted.solved());
+            REQUIRE(fitted.stats.table_bytes <= 64 * 1024);
+        }
+
+        auto unlimited = solver.solve(game, SearchBudget::within(std::chrono::minutes(1)));
+        REQUIRE(unlimited.solved());
+        REQUIRE(unlimited.stats.table_bytes > 0);
+    }
+}
+
+TEST_CASE("Solving - memory budget covers queued states") {
+    std::vector<std::string> map = {
+            "##############",
+            "########  ####",
+            "#          ###",
+            "# @xx ##   ..#",
+            "# xx   ##  ..#",
+            "#         ####",
+            "##############",
+    };
+    Level level(map);
+    GameState game(level, {3, 2}, {{3, 3}, {3, 4}, {4, 2}, {4, 3}});
+
+    // open lists, frontiers and search nodes count as well, so the search stops within one expansion of the cap
+    constexpr size_t CAP = 16 * 1024;
+    constexpr size_t ONE_EXPANSION = 4 * 1024;
+    for (SolverMode mode : {SolverMode::GREEDY_DFS, SolverMode::A_STAR, SolverMode::PARALLEL,
+                            SolverMode::HDA_STAR, SolverMode::BIDIRECTIONAL}) {
+        Solver solver(level, mode, 2);
+        SearchBudget budget = SearchBudget::within(std::chrono::minutes(1));
+        budget.max_table_bytes = CAP;
+        auto result = solver.solve(game, budget);
+        REQUIRE(result.status == SolveStatus::BUDGET_EXHAUSTED);
+        REQUIRE(result.stats.table_bytes > CAP);
+        REQUIRE(result.stats.table_bytes <= CAP + ONE_EXPANSION);
+    }
+}
+
+TEST_CASE("Canonical state - player region") {
+    std::vector<std::string> map = {
+            "#######",
+            "#     #",
+            "#  x  #",
+            "###x###",
+            "#     #",
+            "#######",
+    };
+    Level level(map);
+    GameState top_left(level, {1, 1}, {{2, 3}, {3, 3}});
+    GameState top_right(level, {1, 5}, {{2, 3}, {3, 3}});
+    GameState bottom(level, {4, 5}, {{2, 3}, {3, 3}});
+
+    REQUIRE(top_left.canonical_player_pos() == Point{1, 1});
+    REQUIRE(top_right.canonical_player_pos() == Point{1, 1});
+    REQUIRE(bottom.canonical_player_pos() == Point{4, 1});
+    REQUIRE(top_left.canonical_state() == top_right.canonical_state());
+    REQUIRE(top_left.canonical_state().hash() == top_right.canonical_state().hash());
+    REQUIRE_FALSE(top_left.canonical_state() == bottom.canonical_state());
+}
+
+TEST_CASE("Zobrist hashing - incremental keys") {
+    std::vector<std::string> map = {
+            "#######",
+            "#     #",
+            "#     #",
+            "#######",
+    };
+    Level level(map);
+    GameState game(level, {1, 1}, {{1, 2}, {2, 4}});
+    GameState moved(level, {1, 2}, {{1, 3}, {2, 4}});
+    REQUIRE(Point{1, 2}.hash() != Point{1, 3}.hash());
+
+    size_t initial_hash = game.hash();
+    game.issue_order(Move::D);
+    REQUIRE(game == moved);
+    REQUIRE(game.hash() == moved.hash());
+    REQUIRE(game.box_key() == moved.box_key());
+    REQUIRE(game.hash() != initial_hash);
+    REQUIRE(game.canonical_hash() == GameState(level, {2, 1}, {{1, 3}, {2, 4}}).canonical_hash());
+    REQUIRE(game.canonical_hash() != GameState(level, {1, 5}, {{1, 3}, {2, 4}}).canonical_hash());
+    REQUIRE(game.canonical_state().hash() == game.canonical_hash());
+
+    REQUIRE(game.issue_pull(Move::A));
+    REQUIRE(game.hash() == initial_hash);
+}
+
+TEST_CASE("Packed states - interior cells and deduplication") {
+    std::vector<std::string> map = {
+            "  #####",
+            "###   #",
+            "#     #",
+            "#######",
+    };
+    Level level(map);
+    REQUIRE(level.interior_cells() == 8);
+    REQUIRE(level.interior_index(Point{0, 0}) == Level::NO_INDEX); // floor outside of the walls
+    REQUIRE(level.interior_index(Point{1, 0}) == Level::NO_INDEX);
+    REQUIRE(level.interior_index(Point{1, 3}) == 0);
+
+    PackedStates<uint32_t> states(level);
+    GameState game(level, {2, 1}, {{2, 3}});
+    REQUIRE(states.try_emplace(game, 5).second);
+    REQUIRE_FALSE(states.insert(GameState(level, {2, 2}, {{2, 3}}))); // same player area
+    REQUIRE(states.insert(GameState(level, {1, 3}, {{2, 3}}))); // the box separates the areas
+    REQUIRE(states.try_emplace(GameState(level, {2, 2}, {{2, 3}}), 7).first == 5);
+    REQUIRE(states.insert(GameState(level, {2, 1}, {{2, 4}})));
+
+    states.reserve(100); // rebuilds the index
+    for (size_t y = 1; y <= 5; ++y) {
+        for (size_t box = 3; box <= 5; ++box) {
+            states.insert(GameState(level, {2, y}, {{1, box}})); // the player can walk anywhere around the box
+        }
+    }
+    REQUIRE(states.size() == 3 + 3);
+    REQUIRE_FALSE(states.insert(game));
+    REQUIRE(states.bytes_per_state() < 32);
+}
+
+TEST_CASE("Level - flat grid with sentinel walls") {
+    std::vector<std::string> map = {
+            "  ",
+            " .",
+    };
+    Level level(map);
+    size_t corner = level.index(Point{0, 0});
+    REQUIRE(level.point(corner) == Point{0, 0});
+    REQUIRE(level.is_wall(level.neighbour(corner, Move::W))); // beyond the map, no bounds check needed
+    REQUIRE(level.is_wall(level.neighbour(corner, Move::A)));
+    REQUIRE(level.index(Point{0, 0}.move(Move::W)) == level.neighbour(corner, Move::W));
+    REQUIRE(level.is_target(level.neighbour(level.neighbour(corner, Move::S), Move::D)));
+    REQUIRE(level.type(level.index(Point{1, 0})) == CellType::NONE);
+    REQUIRE_FALSE(level.at(Point{2, 0}));
+    REQUIRE(level.adjacent_walkable(Point{0, 0}).size() == 2);
+
+    GameState game(level, {0, 0}, {{0, 1}});
+    game.issue_order(Move::D); // the crate would leave the map
+    REQUIRE(game.player_pos() == Point{0, 0});
+}
+
+TEST_CASE("Bitboard - flood fill and set operations") {
+    std::vector<std::string> map = {
+            "##########################################################################",
+            "#      #                                                                 #",
+            "#      #                                                                 #",
+            "#      ##########################################################  #######",
+            "#                                                                  #    .#",
+            "##########################################################################",
+    };
+    Level level(map); // rows are wider than a word, so vertical shifts cross word boundaries
+    GameState game(level, {1, 1}, {{4, 60}, {1, 70}});
+
+    Bitboard reachable = game.reachable();
+    REQUIRE(reachable.test(level.index(Point{4, 59})));
+    REQUIRE(reachable.test(level.index(Point{3, 6})));
+    REQUIRE_FALSE(reachable.test(level.index(Point{4, 60})));
+    REQUIRE_FALSE(reachable.test(level.index(Point{4, 61}))); // behind the box
+    REQUIRE_FALSE(reachable.test(level.index(Point{1, 8})));
+    REQUIRE(reachable.first() == level.index(Point{1, 1}));
+    REQUIRE(GameState(level, {1, 70}, {{4, 60}}).canonical_player_pos() == Point{1, 8}); // through the gap
+    REQUIRE(GameState(level, {4, 70}, {{4, 60}}).canonical_player_pos() == Point{4, 68});
+
+    size_t walkable = 0;
+    for (size_t i = 0; i < level.cell_count(); ++i) {
+        walkable += reachable.test(i);
+    }
+    REQUIRE(reachable.count() == walkable);
+    REQUIRE(reachable.count() == 6 * 3 + 59);
+    REQUIRE(game.count_boxes_on_target() == 0);
+    REQUIRE_FALSE(game.is_victory());
+    REQUIRE(GameState(level, {4, 70}, {{4, 72}}).is_victory());
+    REQUIRE(GameState(level, {4, 70}, {{4, 72}}).count_boxes_on_target() == 1);
+
+    std::vector<size_t> cells;
+    game.box_board().for_each([&] (size_t i) { cells.push_back(i); });
+    REQUIRE(cells == std::vector<size_t>{level.index(Point{1, 70}), level.index(Point{4, 60})});
+
+    // the board is too large to fit inline, moving it takes over the words instead of copying them
+    static_assert(std::is_nothrow_move_constructible_v<Bitboard> && std::is_nothrow_move_assignable_v<Bitboard>);
+    static_assert(std::is_nothrow_move_constructible_v<GameState> && std::is_nothrow_move_assignable_v<GameState>);
+    Bitboard copy = reachable;
+    Bitboard moved = std::move(copy);
+    REQUIRE(moved.count() == reachable.count());
+    REQUIRE(copy.count() == 0);
+    copy = std::move(moved);
+    REQUIRE(copy.test(level.index(Point{4, 59})));
+    REQUIRE(copy.count() == reachable.count());
+}
+
+TEST_CASE("Bitboard - capacity kernels agree with the generic fill") {
+    std::vector<std::string> row_walls = {"######", "#    #", "# ## #", "#    #", "######"};
+    for (size_t extra_columns : {0, 6, 12, 30}) { // 64, 128, 256 cells and the generic fallback
+        std::vector<std::string> map = row_walls;
+        for (auto& row : map) {
+            row.insert(row.size() - 1, std::string(extra_columns, row == map.front() || row == map.back() ? '#' : ' '));
+        }
+        Level level(map);
+        GameState game(level, {1, 1}, {{3, 2}});
+        Bitboard reachable = game.reachable();
+
+        size_t walls = 0;
+        for (size_t i = 0; i < level.cell_count(); ++i) {
+            walls += level.is_wall(i);
+        }
+        REQUIRE(reachable.count() == level.cell_count() - walls - 1);
+        REQUIRE_FALSE(reachable.test(level.index(Point{3, 2})));
+        REQUIRE(reachable.test(level.index(Point{3, 1})));
+    }
+    REQUIRE(Level(std::vector<std::string>{"####", "#  #", "####"}).board_capacity() == 64);
+    REQUIRE(Level(std::vector<std::string>(20, std::string(20, '#'))).board_capacity() == 0);
+}
+
+TEST_CASE("Make/unmake push - state is restored") {
+    std::vector<std::string> map = {
+            "#######",
+            "#     #",
+            "#  .  #",
+            "#######",
+    };
+    Level level(map);
+    GameState game(level, {1, 1}, {{2, 2}, {1, 4}});
+    GameState original = game;
+
+    auto first = game.make_push(Point{2, 2}, Move::D); // the player walks behind the box on its own
+    REQUIRE(game.player_pos() == Point{2, 2});
+    REQUIRE(game.has_box(level.index(Point{2, 3})));
+    REQUIRE(game.count_boxes_on_target() == 1);
+    auto second = game.make_push(Point{1, 4}, Move::A);
+    REQUIRE(game == GameState(level, {1, 4}, {{2, 3}, {1, 3}}));
+    REQUIRE(game.hash() == GameState(level, {1, 4}, {{2, 3}, {1, 3}}).hash());
+
+    game.unmake_push(second);
+    game.unmake_push(first);
+    REQUIRE(game == original);
+    REQUIRE(game.hash() == original.hash());
+    REQUIRE(game.box_board() == original.box_board());
+}
+
+TEST_CASE("Path finding - walks around boxes") {
+    std::vector<std::string> map = {
+            "#######",
+            "#     #",
+            "# ### #",
+            "#     #",
+            "#######",
+    };
+    Level level(map);
+    GameState game(level, {1, 1}, {{3, 3}});
+    auto walk_to = [&] (Point goal) {
+        return Paths::plot_path(level, Point{1, 1}, goal, game.walkable());
+    };
+
+    REQUIRE(walk_to(Point{3, 5}));
+    REQUIRE_FALSE(walk_to(Point{3, 3})); // holds the box
+    REQUIRE_FALSE(walk_to(Point{2, 2})); // wall
+    REQUIRE(Paths::as_moves(*walk_to(Point{1, 1})).empty());
+    REQUIRE(Paths::as_string(*walk_to(Point{3, 4})) == "ddddssa");
+    REQUIRE(Paths::as_string(*walk_to(Point{3, 2})) == "ssd");
+}
+
+TEST_CASE("Path finding - repeated and concurrent queries") {
+    std::vector<std::string> map = {
+            "##########",
+            "#    #   #",
+            "#  # # # #",
+            "#  #   # #",
+            "##########",
+    };
+    Level level(map);
+    GameState game(level, {1, 1}, {{2, 1}});
+
+    // every thread reuses its scratch arrays for all of its queries
+    std::vector<std::thread> pool;
+    std::atomic<size_t> mismatches = 0;
+    for (size_t thread = 0; thread < 4; ++thread) {
+        pool.emplace_back([&] {
+            for (size_t i = 0; i < 200; ++i) {
+                auto path = Paths::plot_path(level, Point{1, 1}, Point{3, 8}, game.walkable());
+                if (!path || Paths::as_string(*path) != "dddssddwwddss") {
+                    ++mismatches;
+                }
+            }
+        });
+    }
+    for (auto& thread : pool) {
+        thread.join();
+    }
+    REQUIRE(mismatches == 0);
+    REQUIRE_FALSE(Paths::plot_path(level, Point{1, 1}, Point{2, 1}, game.walkable())); // the box is in the way
+}
+
+TEST_CASE("Level - precomputed walk distances") {
+    std::vector<std::string> maze = {
+            "#######",
+            "#   # #",
+            "# # # #",
+            "# #   #",
+            "#######",
+    };
+    Level level(maze);
+    REQUIRE(level.exact_walk_distances());
+    REQUIRE(level.walk_distance(level.index(Point{1, 1}), level.index(Point{1, 5})) == 8);
+    REQUIRE(level.walk_distance(level.index(Point{3, 1}), level.index(Point{3, 1})) == 0);
+    REQUIRE(level.walk_distance(level.index(Point{1, 1}), level.index(Point{0, 0})) == Level::UNREACHABLE);
+
+    // too large for all pairs: a room split by a wall, with landmark bounds instead
+    std::vector<std::string> room(40, "#" + std::string(38, ' ') + "#");
+    room.front() = room.back() = std::string(40, '#');
+    room[20] = std::string(40, '#');
+    Level large(room);
+    REQUIRE_FALSE(large.exact_walk_distances());
+    for (size_t x = 1; x < 20; x += 3) {
+        for (size_t y = 1; y < 39; y += 5) {
+            size_t bound = large.walk_distance(large.index(Point{1, 1}), large.index(Point{x, y}));
+            REQUIRE(bound <= (x - 1) + (y - 1)); // open room, so the true distance is the manhattan one
+        }
+    }
+    REQUIRE(large.walk_distance(large.index(Point{1, 1}), large.index(Point{30, 30})) == Level::UNREACHABLE);
+
+    GameState game(large, {1, 1}, {});
+    auto path = Paths::plot_path(large, Point{1, 1}, Point{19, 38}, game.walkable());
+    REQUIRE(path);
+    REQUIRE(path->points.size() == 18 + 37 + 1);
+}
+
+TEST_CASE("Deadlocks - dead cells and frozen boxes") {
+    std::vector<std::string> room = {
+            "#######",
+            "#     #",
+            "# .   #",
+            "#     #",
+            "#######",
+    };
+    Level open_room(room);
+    REQUIRE(open_room.dead().count() == 12); // everything along the walls
+    REQUIRE_FALSE(open_room.is_dead(open_room.index(Point{2, 4})));
+
+    // a corridor cell between two dead ends, not even next to a wall it could slide along
+    std::vector<std::string> corridor = {
+            "#####",
+            "#.  #",
+            "### #",
+            "#   #",
+            "#####",
+    };
+    Level dead_end(corridor);
+    REQUIRE(dead_end.is_dead(dead_end.index(Point{2, 3})));
+    REQUIRE_FALSE(dead_end.is_dead(dead_end.index(Point{1, 2})));
+
+    // the only push puts the crate next to another one along the wall: both are frozen off targets,
+    // so the push isn't even generated
+    std::vector<std::string> map = {
+            "#######",
+            "#.   .#",
+            "### ###",
+            "### ###",
+            "#######",
+    };
+    Level level(map);
+    GameState game(level, {3, 3}, {{2, 3}, {1, 4}});
+    auto result = Solver(level).solve(game);
+    REQUIRE(result.status == SolveStatus::UNSOLVABLE);
+    REQUIRE(result.stats.expanded_nodes == 1);
+    REQUIRE(result.stats.generated_nodes == 0);
+}
+
+TEST_CASE("Deadlocks - boxes matched to targets") {
+    // both boxes can only ever reach the upper target: the lower room can't be entered with a box
+    std::vector<std::string> map = {
+            "########",
+            "#.     #",
+            "#      #",
+            "#      #",
+            "###### #",
+            "#.     #",
+            "########",
+    };
+    Level level(map);
+    GameState game(level, {3, 3}, {{2, 3}, {2, 4}});
+    Heuristic heuristic(level);
+    TargetAssignment assignment(level, heuristic);
+    REQUIRE_FALSE(assignment.assignable(game));
+    REQUIRE(TargetAssignment(level, heuristic).assignable(GameState(level, {3, 3}, {{2, 3}})));
+
+    auto result = Solver(level).solve(game);
+    REQUIRE(result.status == SolveStatus::UNSOLVABLE);
+    REQUIRE(result.stats.expanded_nodes == 0);
+    REQUIRE(result.stats.matching_cuts == 1);
+
+    // the matching kept from the previous query agrees with a fresh one while the boxes move around one by one
+    std::vector<std::string> open_map = {
+            "#######",
+            "#.   .#",
+            "#     #",
+            "#     #",
+            "#######",
+    };
+    Level open_level(open_map);
+    Heuristic open_heuristic(open_level);
+    std::vector<std::vector<Point>> configurations = {
+            {{2, 2}, {2, 4}}, {{1, 2}, {2, 4}}, {{1, 2}, {1, 4}}, {{1, 1}, {1, 4}}, {{1, 1}, {3, 4}}, {{1, 1}, {2, 4}},
+    };
+    std::vector<bool> kept_results;
+    TargetAssignment kept(open_level, open_heuristic);
+    for (const auto& boxes : configurations) {
+        kept_results.push_back(kept.assignable(GameState(open_level, {2, 3}, boxes)));
+    }
+    for (size_t i = 0; i < configurations.size(); ++i) {
+        GameState state(open_level, {2, 3}, configurations[i]);
+        REQUIRE(kept_results[i] == TargetAssignment(open_level, open_heuristic).assignable(state));
+    }
+    REQUIRE_FALSE(kept_results[4]); // pushed against the bottom wall
+}
+
+TEST_CASE("Deadlocks - learned patterns") {
+    std::vector<std::string> map = {
+            "########",
+            "###   ##",
+            "#.    ##",
+            "###  .##",
+            "#.##  ##",
+            "# # . ##",
+            "#  .  .#",
+            "#   .  #",
+            "########",
+    };
+    Level level(map);
+    DeadlockPatterns patterns(level);
+    Bitboard pattern(level.cell_count());
+    pattern.set(level.index(Point{6, 3}));
+    pattern.set(level.index(Point{6, 4}));
+    Bitboard boxes = pattern;
+    boxes.set(level.index(Point{2, 3}));
+    REQUIRE_FALSE(patterns.matches(boxes));
+    REQUIRE(patterns.add(pattern));
+    REQUIRE(patterns.matches(boxes));
+    REQUIRE_FALSE(patterns.add(boxes)); // covered by the smaller one already
+    boxes.reset(level.index(Point{6, 4}));
+    REQUIRE_FALSE(patterns.matches(boxes));
+    REQUIRE(patterns.size() == 1);
+
+    // dead ends met by the search teach the solver patterns it cuts later states with, in this search and the next
+    GameState game(level, {2, 2}, {{2, 3}, {3, 4}, {4, 4}, {6, 1}, {6, 3}, {6, 4}, {6, 5}});
+    Solver solver(level);
+    auto first = solver.solve(game);
+    REQUIRE(first.stats.learned_patterns > 0);
+    REQUIRE(first.stats.pattern_cuts > 0);
+    auto second = solver.solve(game);
+    REQUIRE(second.stats.expanded_nodes <= first.stats.expanded_nodes);
+    game.issue_orders(second.moves);
+    REQUIRE(game.is_victory());
+}
+
+TEST_CASE("Deadlocks - small placements table") {
+    std::vector<std::string> map = {
+            "#########",
+            "##   ####",
+            "# . . .##",
+            "# # ## ##",
+            "#       #",
+            "### #   #",
+            "###   ###",
+            "#########",
+    };
+    Level level(map);
+    GameState game(level, {4, 1}, {{4, 2}, {4, 4}, {4, 6}});
+    auto shared = std::make_shared<DeadlockTable>(level);
+
+    // placements are decided as the searches meet them, within their budget: a cancelled one decides nothing
+    SearchBudget cancelled;
+    cancelled.cancellation.cancel();
+    Solver solver(level, SolverMode::GREEDY_DFS, 0, MoveOrdering::BOXES_ON_TARGETS, shared);
+    REQUIRE(solver.solve(game, cancelled).status == SolveStatus::BUDGET_EXHAUSTED);
+    REQUIRE(shared->size() == 0);
+
+    auto result = solver.solve(game);
+    REQUIRE(result.solved());
+    game.issue_orders(result.moves);
+    REQUIRE(game.is_victory());
+    const DeadlockTable& table = solver.deadlock_table();
+    REQUIRE(&table == shared.get());
+
+    REQUIRE(table.size() > 0);
+
+    // two boxes side by side below the wall can't both reach the targets of the row; the search met such a pair
+    Bitboard boxes(level.cell_count());
+    boxes.set(level.index(Point{2, 4}));
+    REQUIRE_FALSE(table.touches_dead(boxes, level.index(Point{2, 4})));
+    boxes.set(level.index(Point{2, 5}));
+    REQUIRE(table.verdict(level.index(Point{2, 4}), 0) == DeadlockTable::DEAD);
+    REQUIRE(table.touches_dead(boxes, level.index(Point{2, 4})));
+    REQUIRE(table.touches_dead(boxes, level.index(Point{2, 5})));
+
+    // solvers sharing the table see what the others decided
+    Solver other(level, SolverMode::A_STAR, 0, MoveOrdering::BOXES_ON_TARGETS, shared);
+    REQUIRE(other.solve(GameState(level, {4, 1}, {{4, 2}, {4, 4}, {4, 6}})).solved());
+    REQUIRE(&other.deadlock_table() == &table);
+}
+
+TEST_CASE("Deadlocks - placements are decided on demand") {
+    // a single push in a large room only proves the placements it makes, not every placement of the room
+    std::vector<std::string> room(40, "#" + std::string(38, ' ') + "#");
+    room.front() = room.back() = std::string(40, '#');
+    room[3][3] = '.';
+    room[3][5] = '.';
+    Level level(room);
+    GameState game(level, {5, 4}, {{4, 3}, {4, 5}});
+
+    Solver solver(level, SolverMode::GREEDY_DFS, 1);
+    auto result = solver.solve(game, SearchBudget::within(std::chrono::seconds(10)));
+    REQUIRE(result.solved());
+    size_t decided = 0;
+    for (size_t anchor = 0; anchor < level.cell_count(); ++anchor) {
+        for (size_t s = 0; s < DeadlockTable::SHAPE_COUNT; ++s) {
+            decided += solver.deadlock_table().verdict(anchor, s) != DeadlockTable::UNDECIDED;
+        }
+    }
+    REQUIRE(decided > 0);
+    REQUIRE(decided < level.cell_count());
+}
+
+TEST_CASE("Deadlocks - proofs with spare targets") {
+    // patterns and placements are proven dead on a few boxes alone, which leaves targets to spare; every one of them
+    // has to be dead for real, or they would cut solvable states
+    std::vector<std::string> map = {
+            "#######",
+            "#  .  #",
+            "#.##  #",
+            "#   #.#",
+            "# .  ##",
+            "#   # #",
+            "#######",
+    };
+    Level level(map);
+    Solver solver(level, SolverMode::GREEDY_DFS, 0, MoveOrdering::GENERATION);
+    GameState game(level, {5, 1}, {{1, 2}, {3, 2}, {4, 2}});
+    auto result = solver.solve(game);
+    REQUIRE(result.solved());
+    game.issue_orders(result.moves);
+    REQUIRE(game.is_victory());
+    auto dead_end = solver.solve(GameState(level, {5, 1}, {{1, 2}, {3, 2}, {4, 3}}));
+    REQUIRE(dead_end.status == SolveStatus::UNSOLVABLE);
+    REQUIRE(dead_end.stats.learned_patterns > 0);
+
+    const DeadlockTable& table = solver.deadlock_table();
+    size_t placements = 0;
+    for (size_t anchor = 0; anchor < level.cell_count(); ++anchor) {
+        for (size_t s = 0; s < DeadlockTable::SHAPE_COUNT; ++s) {
+            const DeadlockTable::Shape& shape = table.shapes()[s];
+            Bitboard boxes(level.cell_count());
+            bool fits = true;
+            for (size_t k = 0; k < shape.boxes; ++k) {
+                size_t cell = anchor + shape.offsets[k];
+                fits = fits && cell < level.cell_count() && !level.is_wall(cell);
+                if (fits) {
+                    boxes.set(cell);
+                }
+            }
+            if (fits && table.touches_dead(boxes, anchor)) {
+                ++placements;
+                REQUIRE_FALSE(solvable_from_anywhere(level, boxes));
+            }
+        }
+    }
+    REQUIRE(placements > 0);
+    solver.deadlock_patterns().for_each([&] (const Bitboard& pattern) {
+        REQUIRE_FALSE(solvable_from_anywhere(level, pattern));
+    });
+}
+
+TEST_CASE("Solving - PI-corral pruning") {
+    // the right room can only be opened by pushing the box in the doorway into it, so nothing else is generated:
+    // just the push of that box into the room, and the macro push straight on to its target
+    std::vector<std::string> map = {
+            "#########",
+            "# . #   #",
+            "#@x x . #",
+            "#   #   #",
+            "#########",
+    };
+    Level level(map);
+    GameState game(level, {2, 1}, {{2, 2}, {2, 4}});
+
+    SearchBudget budget;
+    budget.max_expanded_nodes = 1;
+    auto first = Solver(level, SolverMode::GREEDY_DFS, 0, MoveOrdering::GENERATION).solve(game, budget);
+    REQUIRE(first.stats.expanded_nodes == 1);
+    REQUIRE(first.stats.generated_nodes == 2);
+
+    auto result = Solver(level).solve(game);
+    REQUIRE(result.solved());
+    game.issue_orders(result.moves);
+    REQUIRE(game.is_victory());
+}
+
+TEST_CASE("Solving - PI-corral pruning with spare targets") {
+    // empty targets inside a corral don't have to be filled when there are more targets than boxes: only the corral's
+    // boxes off their targets make it worth pushing into first
+    std::vector<std::string> map = {
+            "######",
+            "#    #",
+            "##.  #",
+            "#  . #",
+            "#.# .#",
+            "# #.##",
+            "# . ##",
+            "######",
+    };
+    Level level(map);
+    GameState game(level, {3, 2}, {{3, 4}, {5, 3}, {4, 1}});
+    for (SolverMode mode : {SolverMode::GREEDY_DFS, SolverMode::A_STAR, SolverMode::IDA_STAR,
+                            SolverMode::PARALLEL, SolverMode::HDA_STAR, SolverMode::BIDIRECTIONAL}) {
+        auto result = Solver(level, mode, 2).solve(game);
+        REQUIRE(result.solved());
+        REQUIRE(count_pushes(game, result.moves) == 1);
+    }
+
+    std::vector<std::string> wide = {
+            "#########",
+            "#. #    #",
+            "# #  ##.#",
+            "#..     #",
+            "#       #",
+            "#       #",
+            "#########",
+    };
+    Level wide_level(wide);
+    GameState wide_game(wide_level, {3, 6}, {{2, 4}, {4, 5}, {3, 4}});
+    for (SolverMode mode : {SolverMode::A_STAR, SolverMode::IDA_STAR, SolverMode::HDA_STAR}) {
+        auto result = Solver(wide_level, mode, 2).solve(wide_game);
+        REQUIRE(result.solved());
+        REQUIRE(count_pushes(wide_game, result.moves) == 10);
+    }
+}
+
+TEST_CASE("Solving - tunnel and goal room macro pushes") {
+    // once both the box and the player are in the corridor, the box goes through it in one push
+    std::vector<std::string> corridor = {
+            "###########",
+            "#   #######",
+            "#@x      .#",
+            "#   #######",
+            "###########",
+    };
+    Level tunnel_level(corridor);
+    REQUIRE(tunnel_level.is_tunnel(tunnel_level.index(Point{2, 5}), Move::D));
+    REQUIRE_FALSE(tunnel_level.is_tunnel(tunnel_level.index(Point{2, 5}), Move::S));
+    GameState tunnel_game(tunnel_level, {2, 1}, {{2, 2}});
+    auto tunnel_result = Solver(tunnel_level).solve(tunnel_game);
+    REQUIRE(tunnel_result.stats.expanded_nodes == 3);
+    REQUIRE(count_pushes(tunnel_game, tunnel_result.moves) == 7);
+    tunnel_game.issue_orders(tunnel_result.moves);
+    REQUIRE(tunnel_game.is_victory());
+
+    // a push through the doorway of the goal room may also take the box straight to the farthest target in line
+    std::vector<std::string> rooms = {
+            "#########",
+            "#   #####",
+            "#   #  .#",
+            "#  @x  .#",
+            "#   #####",
+            "#########",
+    };
+    Level room_level(rooms);
+    REQUIRE(room_level.enters_goal_room(room_level.index(Point{3, 4}), Move::D));
+    REQUIRE_FALSE(room_level.enters_goal_room(room_level.index(Point{3, 4}), Move::A));
+    GameState room_game(room_level, {3, 3}, {{3, 4}});
+    auto room_result = Solver(room_level).solve(room_game);
+    REQUIRE(room_result.stats.expanded_nodes == 1);
+    REQUIRE(room_result.stats.generated_nodes == 2);
+    REQUIRE(count_pushes(room_game, room_result.moves) == 3);
+    room_game.issue_orders(room_result.moves);
+    REQUIRE(room_game.is_victory());
 }
\ No newline at end of file